@@ -21,16 +21,146 @@
 
 #include "Memory.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
 namespace hype {
 
     template<typename T>
     class AssociativeMemory : public Memory<T> {
+    private:
+        static std::uint64_t next_generation() {
+            static std::atomic<std::uint64_t> generations(0);
+            return ++generations;
+        }
+
+        // Anything but an update of individual prototypes invalidates everything an index knows.
+        void restructured() {
+            generation_ = next_generation();
+            modified_.clear();
+            flagged.clear();
+        }
+
     public:
+        AssociativeMemory() = default;
+
+        AssociativeMemory(const AssociativeMemory &other) : Memory<T>(other) {}
+
+        AssociativeMemory(AssociativeMemory &&other) noexcept : Memory<T>(std::move(other)) {}
+
+        AssociativeMemory &operator=(const AssociativeMemory &other) {
+            Memory<T>::operator=(other);
+            restructured();
+            return *this;
+        }
+
+        AssociativeMemory &operator=(AssociativeMemory &&other) noexcept {
+            Memory<T>::operator=(std::move(other));
+            restructured();
+            return *this;
+        }
+
+        // Mutable access is taken to modify the prototype, which is recorded in modified().
+        T &operator[](std::size_t i) {
+            T &result = this->data.at(i);
+            if (flagged.size() != this->data.size()) {
+                flagged.resize(this->data.size(), false);
+            }
+            if (!flagged[i]) {
+                flagged[i] = true;
+                modified_.emplace_back(i);
+            }
+            return result;
+        }
+
+        const T &operator[](std::size_t i) const {
+            return this->data.at(i);
+        }
+
+        void load(const std::string &path) {
+            Memory<T>::load(path);
+            restructured();
+        }
+
+        void clear() {
+            Memory<T>::clear();
+            restructured();
+        }
+
         void insert(const T &&data) {
             this->data.emplace_back(std::move(data));
+            restructured();
+        }
+
+        // Changes whenever prototypes are added, removed or replaced wholesale.
+        [[nodiscard]]
+        std::uint64_t generation() const {
+            return generation_;
+        }
+
+        // Prototypes handed out for modification since the last generation change or clear_modified().
+        [[nodiscard]]
+        const std::vector<std::size_t> &modified() const {
+            return modified_;
+        }
+
+        void clear_modified() {
+            modified_.clear();
+            flagged.clear();
+        }
+
+        // Replaces the contents with one prototype per class, bundled from the first `dataset_fraction` of that class's
+        // samples. `dataset` can be anything indexable by position yielding (vector, label) pairs, with labels in
+        // [0, classes). Each class has its own running accumulator and the classes are split across threads, so the
+        // samples are neither copied nor grouped first.
+        template<typename Dataset>
+        void build_from(const Dataset &dataset, float dataset_fraction = 1.0) {
+            std::vector<std::size_t> limits;
+            for (std::size_t i = 0; i < dataset.size(); ++i) {
+                const auto &label = dataset[i].second;
+                if (label < 0) {
+                    throw error("Failed to build associative memory: encountered negative label (", label, ").");
+                }
+                if (static_cast<std::size_t>(label) >= limits.size()) {
+                    limits.resize(label + 1, 0);
+                }
+                ++limits[label];
+            }
+            for (auto &limit: limits) {
+                limit = static_cast<std::size_t>(limit * dataset_fraction);
+            }
+
+            std::vector<typename T::Accumulator> accumulators(limits.size());
+            std::size_t workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                        limits.size());
+            std::vector<std::thread> threads;
+            for (std::size_t worker = 0; worker < workers; ++worker) {
+                threads.emplace_back([&, worker]() {
+                    for (std::size_t i = 0; i < dataset.size(); ++i) {
+                        const auto &[vector, label] = dataset[i];
+                        if (label % workers == worker && accumulators[label].size() < limits[label]) {
+                            accumulators[label].add(vector);
+                        }
+                    }
+                });
+            }
+            for (auto &thread: threads) {
+                thread.join();
+            }
+
+            this->clear();
+            for (const auto &accumulator: accumulators) {
+                this->data.emplace_back(accumulator.result());
+            }
+            restructured();
         }
 
-        std::size_t find(const T &query) const {
+        // `query` may be of any type T can measure its distance to.
+        template<typename Q>
+        std::size_t find(const Q &query) const {
             if (this->size() == 0) {
                 throw error("Failed to find query in empty associative memory.");
             }
@@ -48,6 +178,11 @@ namespace hype {
 
             return index;
         }
+
+    private:
+        std::uint64_t generation_ = next_generation();
+        std::vector<std::size_t> modified_;
+        std::vector<bool> flagged;
     };
 
 } // namespace hype
@@ -0,0 +1,284 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Kernels.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hype {
+
+    // Fixed-size bit set with the parts of the std::bitset interface BinaryVector uses, stored as 64-bit words so the
+    // word-level kernels can run over it directly. Bits past D are kept zero.
+    template<std::size_t D>
+    class Bits {
+    public:
+        static constexpr std::size_t WORDS = (D + 63) / 64;
+
+        class reference {
+        public:
+            reference(std::uint64_t &word_, std::uint64_t mask_) : word(word_), mask(mask_) {}
+
+            reference(const reference &other) = default;
+
+            operator bool() const {
+                return (word & mask) != 0;
+            }
+
+            reference &operator=(bool value) {
+                if (value) {
+                    word |= mask;
+                } else {
+                    word &= ~mask;
+                }
+                return *this;
+            }
+
+            reference &operator=(const reference &other) {
+                return *this = static_cast<bool>(other);
+            }
+
+        private:
+            std::uint64_t &word;
+            std::uint64_t mask;
+        };
+
+        Bits() : words{} {}
+
+        reference operator[](std::size_t index) {
+            return reference(words[index / 64], std::uint64_t{1} << (index % 64));
+        }
+
+        bool operator[](std::size_t index) const {
+            return (words[index / 64] >> (index % 64)) & 1;
+        }
+
+        Bits &flip(std::size_t index) {
+            words[index / 64] ^= std::uint64_t{1} << (index % 64);
+            return *this;
+        }
+
+        [[nodiscard]]
+        std::size_t count() const {
+            return kernels().popcount(words.data(), WORDS);
+        }
+
+        // Most significant bit first, like std::bitset::to_string.
+        [[nodiscard]]
+        std::string to_string() const {
+            std::string result(D, '0');
+            for (std::size_t i = 0; i < D; ++i) {
+                if ((*this)[i]) {
+                    result[D - 1 - i] = '1';
+                }
+            }
+            return result;
+        }
+
+        std::uint64_t *data() {
+            return words.data();
+        }
+
+        const std::uint64_t *data() const {
+            return words.data();
+        }
+
+        friend Bits operator^(const Bits &one, const Bits &two) {
+            Bits result;
+            for (std::size_t i = 0; i < WORDS; ++i) {
+                result.words[i] = one.words[i] ^ two.words[i];
+            }
+            return result;
+        }
+
+        Bits &operator^=(const Bits &other) {
+            for (std::size_t i = 0; i < WORDS; ++i) {
+                words[i] ^= other.words[i];
+            }
+            return *this;
+        }
+
+        friend Bits operator|(const Bits &one, const Bits &two) {
+            Bits result;
+            for (std::size_t i = 0; i < WORDS; ++i) {
+                result.words[i] = one.words[i] | two.words[i];
+            }
+            return result;
+        }
+
+        friend Bits operator&(const Bits &one, const Bits &two) {
+            Bits result;
+            for (std::size_t i = 0; i < WORDS; ++i) {
+                result.words[i] = one.words[i] & two.words[i];
+            }
+            return result;
+        }
+
+        Bits operator~() const {
+            Bits result;
+            for (std::size_t i = 0; i < WORDS; ++i) {
+                result.words[i] = ~words[i];
+            }
+            if constexpr (D % 64 != 0) {
+                result.words[WORDS - 1] &= (std::uint64_t{1} << (D % 64)) - 1;
+            }
+            return result;
+        }
+
+    private:
+        std::array<std::uint64_t, WORDS> words;
+    };
+
+    // Counts how many of a stream of bit sets have each of the D bits set, bit-sliced: plane k holds bit k of all D
+    // counts, so every word operation advances 64 counters at once. Planes are added as the counts outgrow them.
+    template<std::size_t D>
+    class BitCounts {
+    public:
+        // Ripple-carry increment of the counters whose bit is set. Carries die out quickly, so this costs about two
+        // word operations per word on average.
+        void add(const Bits<D> &bits) {
+            reserve(count + 1);
+            for (std::size_t w = 0; w < Bits<D>::WORDS; ++w) {
+                carry(0, w, bits.data()[w]);
+            }
+            ++count;
+        }
+
+        // Adds `n` bit sets at once, `bits(i)` being the i-th. Per word, the inputs are first reduced by a tree of
+        // carry-save adders, which turns three words of one weight into one of that weight and one of the next, so
+        // only the couple of words left at each weight need carrying into the counters.
+        template<typename F>
+        void add(std::size_t n, F &&bits) {
+            if (n == 0) {
+                return;
+            }
+            reserve(count + n);
+            for (std::size_t w = 0; w < Bits<D>::WORDS; ++w) {
+                // Up to two words of weight 2^k waiting to be added.
+                std::uint64_t pending[64][2];
+                std::size_t waiting[64] = {};
+                for (std::size_t i = 0; i < n; ++i) {
+                    std::uint64_t word = bits(i).data()[w];
+                    for (std::size_t k = 0;; ++k) {
+                        if (waiting[k] < 2) {
+                            pending[k][waiting[k]++] = word;
+                            break;
+                        }
+                        std::uint64_t a = pending[k][0];
+                        std::uint64_t b = pending[k][1];
+                        pending[k][0] = a ^ b ^ word;
+                        waiting[k] = 1;
+                        word = (a & b) | (word & (a ^ b));
+                    }
+                }
+                for (std::size_t k = 0; k < 64 && (1ULL << k) <= n; ++k) {
+                    for (std::size_t j = 0; j < waiting[k]; ++j) {
+                        carry(k, w, pending[k][j]);
+                    }
+                }
+            }
+            count += n;
+        }
+
+        // The bits whose count exceeds `threshold`, found by comparing all counters against it plane by plane from
+        // the most significant one down.
+        Bits<D> greater_than(std::size_t threshold) const {
+            Bits<D> result;
+            if (threshold >> std::min<std::size_t>(planes.size(), 63) != 0) {
+                return result;
+            }
+            for (std::size_t w = 0; w < Bits<D>::WORDS; ++w) {
+                std::uint64_t greater = 0;
+                std::uint64_t equal = ~std::uint64_t{0};
+                for (std::size_t k = planes.size(); k-- > 0;) {
+                    std::uint64_t plane = planes[k].data()[w];
+                    if ((threshold >> k) & 1) {
+                        equal &= plane;
+                    } else {
+                        greater |= equal & plane;
+                        equal &= ~plane;
+                    }
+                }
+                result.data()[w] = greater;
+            }
+            return result;
+        }
+
+        // The count of bit `index`.
+        [[nodiscard]]
+        std::size_t operator[](std::size_t index) const {
+            std::size_t result = 0;
+            for (std::size_t k = 0; k < planes.size(); ++k) {
+                result |= static_cast<std::size_t>(planes[k][index]) << k;
+            }
+            return result;
+        }
+
+        // Writes all D counts to `out`, a plane at a time rather than a counter at a time.
+        template<typename T>
+        void counts(T *out) const {
+            std::fill(out, out + D, T(0));
+            for (std::size_t k = 0; k < planes.size(); ++k) {
+                const std::uint64_t *words = planes[k].data();
+                T weight = static_cast<T>(std::size_t{1} << k);
+                for (std::size_t d = 0; d < D; ++d) {
+                    out[d] += static_cast<T>((words[d / 64] >> (d % 64)) & 1) * weight;
+                }
+            }
+        }
+
+        // Resets every count to zero, keeping the planes allocated for the next round.
+        void clear() {
+            std::fill(planes.begin(), planes.end(), Bits<D>());
+            count = 0;
+        }
+
+        // How many bit sets were added.
+        [[nodiscard]]
+        std::size_t size() const {
+            return count;
+        }
+
+    private:
+        // Makes room for counts up to `total`, so carries never run off the top plane.
+        void reserve(std::size_t total) {
+            while (planes.size() < 64 && (total >> planes.size()) != 0) {
+                planes.emplace_back();
+            }
+        }
+
+        void carry(std::size_t plane, std::size_t w, std::uint64_t word) {
+            for (std::size_t k = plane; word != 0; ++k) {
+                std::uint64_t &counter = planes[k].data()[w];
+                std::uint64_t overflow = counter & word;
+                counter ^= word;
+                word = overflow;
+            }
+        }
+
+        std::vector<Bits<D>> planes;
+        std::size_t count = 0;
+    };
+} // namespace hype
@@ -0,0 +1,140 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace hype {
+
+    // Bounded multi-producer multi-consumer queue after Dmitry Vyukov's design. Every cell carries a sequence
+    // number which tells producers and consumers whether it is theirs to write or read, so neither side ever
+    // takes a lock. The blocking push()/pop() merely spin and yield on top of the non-blocking variants.
+    template<typename T>
+    class BoundedQueue {
+    private:
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        static std::size_t round_up(std::size_t capacity) {
+            std::size_t result = 2;
+            while (result < capacity) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+    public:
+        explicit BoundedQueue(std::size_t capacity) : mask(round_up(capacity) - 1), cells(mask + 1) {
+            for (std::size_t i = 0; i < cells.size(); ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue &) = delete;
+
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        bool try_push(T &&value) {
+            std::size_t position = tail.load(std::memory_order_relaxed);
+            while (true) {
+                Cell &cell = cells[position & mask];
+                std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+                if (difference == 0) {
+                    if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.value = std::move(value);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool try_pop(T &value) {
+            std::size_t position = head.load(std::memory_order_relaxed);
+            while (true) {
+                Cell &cell = cells[position & mask];
+                std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+                if (difference == 0) {
+                    if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = std::move(cell.value);
+                        cell.sequence.store(position + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Returns false if the queue was closed before the value could be pushed.
+        bool push(T &&value) {
+            while (!closed()) {
+                if (try_push(std::move(value))) {
+                    return true;
+                }
+                std::this_thread::yield();
+            }
+            return false;
+        }
+
+        // Returns false once the queue is closed and drained.
+        bool pop(T &value) {
+            while (true) {
+                if (try_pop(value)) {
+                    return true;
+                }
+                if (closed()) {
+                    return try_pop(value);
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void close() {
+            is_closed.store(true, std::memory_order_seq_cst);
+        }
+
+        bool closed() const {
+            return is_closed.load(std::memory_order_seq_cst);
+        }
+
+    private:
+        const std::size_t mask;
+        std::vector<Cell> cells;
+        alignas(64) std::atomic<std::size_t> head{0};
+        alignas(64) std::atomic<std::size_t> tail{0};
+        std::atomic<bool> is_closed{false};
+    };
+
+} // namespace hype
@@ -0,0 +1,143 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "AssociativeMemory.h"
+
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace hype {
+
+    namespace detail {
+        // add() and sub() are found by argument-dependent lookup only, which member functions of the same names hide.
+        template<typename T, typename V>
+        T added(const T &one, const V &two) {
+            return add(one, two);
+        }
+
+        template<typename T, typename V>
+        T subtracted(const T &one, const V &two) {
+            return sub(one, two);
+        }
+    } // namespace detail
+
+    // An associative memory whose prototypes may be updated while other threads query it, for learning online on the
+    // model being served. Each class has its own reader-writer lock: find() holds a class's lock shared while measuring
+    // the distance to it, and updates hold it exclusively, so queries only wait on updates to the class they are
+    // measuring and updates of different classes never wait on each other.
+    //
+    // Every update to a class is linearizable, and find() measures each prototype between whole updates, never one
+    // half applied. It does not see all classes at one instant, however: a query running alongside updates to two
+    // classes may see the update to one and not the other. The set of classes is fixed at construction.
+    template<typename T>
+    class ConcurrentAssociativeMemory {
+    private:
+        struct alignas(64) Lock {
+            std::shared_mutex mutex;
+        };
+
+    public:
+        explicit ConcurrentAssociativeMemory(const AssociativeMemory<T> &memory)
+                : prototypes(memory.begin(), memory.end()), locks(memory.size()) {}
+
+        ConcurrentAssociativeMemory(const ConcurrentAssociativeMemory &) = delete;
+
+        ConcurrentAssociativeMemory &operator=(const ConcurrentAssociativeMemory &) = delete;
+
+        [[nodiscard]]
+        std::size_t size() const {
+            return prototypes.size();
+        }
+
+        template<typename Q>
+        std::size_t find(const Q &query) const {
+            if (prototypes.empty()) {
+                throw error("Failed to find query in empty associative memory.");
+            }
+
+            std::size_t index = 0;
+            float min_distance = std::numeric_limits<float>::max();
+
+            for (std::size_t i = 0; i < prototypes.size(); ++i) {
+                float tmp_distance;
+                {
+                    std::shared_lock<std::shared_mutex> lock(locks[i].mutex);
+                    tmp_distance = query.distance(prototypes[i]);
+                }
+                if (tmp_distance < min_distance) {
+                    index = i;
+                    min_distance = tmp_distance;
+                }
+            }
+
+            return index;
+        }
+
+        template<typename V>
+        void add(std::size_t i, const V &delta) {
+            update(i, [&](T &prototype) { prototype = detail::added(prototype, delta); });
+        }
+
+        template<typename V>
+        void sub(std::size_t i, const V &delta) {
+            update(i, [&](T &prototype) { prototype = detail::subtracted(prototype, delta); });
+        }
+
+        // Applies `f` to prototype `i` as one update.
+        template<typename Function>
+        void update(std::size_t i, Function &&f) {
+            std::unique_lock<std::shared_mutex> lock(locks.at(i).mutex);
+            f(prototypes[i]);
+        }
+
+        // The perceptron step of retraining: if `input` is closest to another class than `label`, moves it away from
+        // that class and towards its own. The two updates are separate, so a query may see one without the other.
+        // Returns whether it was misclassified.
+        template<typename V>
+        bool learn(const V &input, std::size_t label) {
+            std::size_t prediction = find(input);
+            if (prediction == label) {
+                return false;
+            }
+            sub(prediction, input);
+            add(label, input);
+            return true;
+        }
+
+        // Copies the prototypes, each taken between updates to it, e.g. to save them.
+        AssociativeMemory<T> snapshot() const {
+            AssociativeMemory<T> result;
+            for (std::size_t i = 0; i < prototypes.size(); ++i) {
+                std::shared_lock<std::shared_mutex> lock(locks[i].mutex);
+                result.insert(T(prototypes[i]));
+            }
+            return result;
+        }
+
+    private:
+        std::vector<T> prototypes;
+        mutable std::vector<Lock> locks;
+    };
+
+} // namespace hype
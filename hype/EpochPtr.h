@@ -0,0 +1,150 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Utils.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace hype {
+
+    // An object which readers use without locks while a writer replaces it, reclaiming old versions by epochs. A reader
+    // announces the current epoch in a slot before loading the pointer and clears the slot when done. publish() swaps
+    // the pointer, advances the epoch and only destroys the previous version once every slot is idle or announces the
+    // new epoch, so readers finish on whichever version they started with. Announcements may be stale, which only
+    // makes the writer wait longer. Reading costs one compare-and-swap on a slot picked by thread, so readers on
+    // different threads rarely share one; it spins only while all SLOTS slots are busy.
+    template<typename T>
+    class EpochPtr {
+    private:
+        static constexpr std::size_t SLOTS = 64;
+        static constexpr std::uint64_t IDLE = 0;
+
+        struct alignas(64) Slot {
+            std::atomic<std::uint64_t> epoch{IDLE};
+        };
+
+    public:
+        // Keeps a version alive while it is held. Must not outlive the EpochPtr, nor be held by a thread that publishes,
+        // as publish() would wait for it forever.
+        class Snapshot {
+        public:
+            Snapshot(const Snapshot &) = delete;
+
+            Snapshot &operator=(const Snapshot &) = delete;
+
+            Snapshot(Snapshot &&other) noexcept : slot(other.slot), value(other.value) {
+                other.slot = nullptr;
+            }
+
+            ~Snapshot() {
+                if (slot != nullptr) {
+                    slot->epoch.store(IDLE, std::memory_order_release);
+                }
+            }
+
+            const T &operator*() const {
+                return *value;
+            }
+
+            const T *operator->() const {
+                return value;
+            }
+
+        private:
+            friend class EpochPtr;
+
+            Snapshot(Slot *slot_, const T *value_) : slot(slot_), value(value_) {}
+
+            Slot *slot;
+            const T *value;
+        };
+
+        explicit EpochPtr(std::unique_ptr<T> initial) : current(initial.release()) {
+            if (current.load() == nullptr) {
+                throw error("EpochPtr needs an initial value.");
+            }
+        }
+
+        EpochPtr(const EpochPtr &) = delete;
+
+        EpochPtr &operator=(const EpochPtr &) = delete;
+
+        ~EpochPtr() {
+            delete current.load();
+        }
+
+        Snapshot read() const {
+            std::size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % SLOTS;
+            for (std::size_t attempt = 0;; ++attempt) {
+                Slot &slot = slots[(start + attempt) % SLOTS];
+                std::uint64_t expected = IDLE;
+                if (slot.epoch.compare_exchange_strong(expected, epoch.load())) {
+                    return Snapshot(&slot, current.load());
+                }
+                if ((attempt + 1) % SLOTS == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Makes `next` the version new readers see, then waits for readers of the previous version to finish and
+        // destroys it. Returns how long that wait, the grace period, took. Concurrent publishers take turns.
+        std::chrono::steady_clock::duration publish(std::unique_ptr<T> next) {
+            std::lock_guard<std::mutex> lock(publishing);
+            std::unique_ptr<T> previous(current.exchange(next.release()));
+            std::uint64_t published = epoch.fetch_add(1) + 1;
+
+            auto start = std::chrono::steady_clock::now();
+            for (const auto &slot: slots) {
+                while (true) {
+                    std::uint64_t announced = slot.epoch.load();
+                    if (announced == IDLE || announced >= published) {
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            return std::chrono::steady_clock::now() - start;
+        }
+
+        // Number of versions published so far.
+        [[nodiscard]]
+        std::uint64_t version() const {
+            return epoch.load() - 1;
+        }
+
+    private:
+        std::atomic<T *> current;
+        // Starts past IDLE, so that every announcement differs from it.
+        std::atomic<std::uint64_t> epoch{1};
+        mutable std::array<Slot, SLOTS> slots;
+        std::mutex publishing;
+    };
+
+} // namespace hype
@@ -21,6 +21,8 @@
 
 #include "Memory.h"
 
+#include <vector>
+
 namespace hype {
 
     template<typename T>
@@ -33,6 +35,63 @@ namespace hype {
                 this->data.emplace_back(T(seedingStrategy));
             }
         }
+
+        // Restricts the channels visited by for_each_channel() to those flagged in `keep`; an empty mask, or one
+        // keeping every channel, restores all of them. Channels masked out are never read.
+        void mask(const std::vector<bool> &keep) {
+            if (!keep.empty() && keep.size() != this->size()) {
+                throw error("Channel mask of ", keep.size(), " channels does not fit memory of ", this->size(), ".");
+            }
+            channels_.clear();
+            for (std::size_t i = 0; i < keep.size(); ++i) {
+                if (keep[i]) {
+                    channels_.emplace_back(i);
+                }
+            }
+            masked_ = channels_.size() != keep.size();
+            if (!masked_) {
+                channels_.clear();
+            }
+        }
+
+        // One flag per channel, set for those kept.
+        [[nodiscard]]
+        std::vector<bool> mask() const {
+            std::vector<bool> result(this->size(), !masked_);
+            for (auto i: channels_) {
+                result[i] = true;
+            }
+            return result;
+        }
+
+        [[nodiscard]]
+        bool masked() const {
+            return masked_;
+        }
+
+        // Indices of the channels kept by the mask, in order; empty unless masked().
+        [[nodiscard]]
+        const std::vector<std::size_t> &channels() const {
+            return channels_;
+        }
+
+        // Calls `f(index, vector)` for every channel kept by the mask.
+        template<typename Function>
+        void for_each_channel(Function &&f) const {
+            if (!masked_) {
+                for (std::size_t i = 0; i < this->size(); ++i) {
+                    f(i, this->data[i]);
+                }
+                return;
+            }
+            for (auto i: channels_) {
+                f(i, this->data.at(i));
+            }
+        }
+
+    private:
+        std::vector<std::size_t> channels_;
+        bool masked_ = false;
     };
 
 } // namespace hype
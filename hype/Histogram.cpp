@@ -0,0 +1,88 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Histogram.h"
+#include "Utils.h"
+
+#include <cmath>
+
+namespace hype {
+
+    std::size_t LatencyHistogram::index(std::uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        unsigned magnitude = 63 - __builtin_clzll(value);
+        unsigned shift = magnitude - (PRECISION - 1);
+        return shift * HALF + (value >> shift);
+    }
+
+    std::uint64_t LatencyHistogram::highest_equivalent(std::size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        std::uint64_t shift = index / HALF - 1;
+        std::uint64_t sub_bucket = index - shift * HALF;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram &other) {
+        for (std::size_t i = 0; i < COUNTS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        if (other.maximum > maximum) {
+            maximum = other.maximum;
+        }
+    }
+
+    void LatencyHistogram::clear() {
+        counts.fill(0);
+        total = 0;
+        maximum = 0;
+    }
+
+    std::uint64_t LatencyHistogram::percentile(double percent) const {
+        if (total == 0) {
+            return 0;
+        }
+
+        auto target = static_cast<std::uint64_t>(std::ceil(percent / 100.0 * total));
+        if (target == 0) {
+            target = 1;
+        }
+
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < COUNTS; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                return std::min(highest_equivalent(i), maximum);
+            }
+        }
+        return maximum;
+    }
+
+    std::string LatencyHistogram::summary() const {
+        return concat("p50: ", percentile(50) / 1000.0, "µs, p90: ", percentile(90) / 1000.0, "µs, p99: ",
+                      percentile(99) / 1000.0, "µs, p99.9: ", percentile(99.9) / 1000.0, "µs, max: ",
+                      max() / 1000.0, "µs (", count(), " samples)");
+    }
+
+} // namespace hype
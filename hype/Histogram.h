@@ -0,0 +1,99 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace hype {
+
+    // Latency histogram in the style of HdrHistogram: values (in nanoseconds) fall into log-linear buckets with 64
+    // sub-buckets per power of two, so any recorded value is reported within 1.6% while recording is just an index
+    // computation and an increment. Not thread-safe; record per thread and merge().
+    class LatencyHistogram {
+    private:
+        static constexpr unsigned PRECISION = 7;
+        static constexpr std::uint64_t SUB_BUCKETS = 1ULL << PRECISION;
+        static constexpr std::uint64_t HALF = SUB_BUCKETS / 2;
+        static constexpr std::size_t COUNTS = (64 - PRECISION + 2) * HALF;
+
+        static std::size_t index(std::uint64_t value);
+
+        static std::uint64_t highest_equivalent(std::size_t index);
+
+    public:
+        void record(std::uint64_t nanoseconds) {
+            ++counts[index(nanoseconds)];
+            ++total;
+            if (nanoseconds > maximum) {
+                maximum = nanoseconds;
+            }
+        }
+
+        void record(std::chrono::steady_clock::duration duration) {
+            record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        }
+
+        void merge(const LatencyHistogram &other);
+
+        void clear();
+
+        [[nodiscard]]
+        std::uint64_t count() const {
+            return total;
+        }
+
+        [[nodiscard]]
+        std::uint64_t max() const {
+            return maximum;
+        }
+
+        // Value below which `percent` percent of the recorded values fall, in nanoseconds.
+        [[nodiscard]]
+        std::uint64_t percentile(double percent) const;
+
+        // p50, p90, p99, p99.9 and max in microseconds.
+        [[nodiscard]]
+        std::string summary() const;
+
+    private:
+        std::array<std::uint64_t, COUNTS> counts{};
+        std::uint64_t total = 0;
+        std::uint64_t maximum = 0;
+    };
+
+    // Runs `function`, records how long it took in `histogram` and returns its result.
+    template<typename F>
+    decltype(auto) measure(LatencyHistogram &histogram, F &&function) {
+        struct Timer {
+            ~Timer() {
+                histogram.record(std::chrono::steady_clock::now() - start);
+            }
+
+            LatencyHistogram &histogram;
+            std::chrono::steady_clock::time_point start;
+        } timer{histogram, std::chrono::steady_clock::now()};
+        return function();
+    }
+
+} // namespace hype
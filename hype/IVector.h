@@ -20,27 +20,46 @@
 #pragma once
 
 #include <cstddef>
-#include <random>
 
 namespace hype {
-    template<std::size_t D, typename T, typename R, typename CR>
+    // Static interface of a hypervector. Implementations derive from IVector<Implementation, ...> (CRTP) and define
+    // size(), operator[], distance() and invert() themselves, so calls on the concrete type are resolved, inlined and
+    // vectorised at compile time. Code written against the interface can still go through IVector, which forwards to
+    // the implementation without any virtual dispatch.
+    template<typename Derived, std::size_t D, typename T, typename R, typename CR>
     class IVector {
-    protected:
-        std::mt19937 random_source;
-
     public:
-        IVector() : random_source(std::random_device{}()) {}
+        Derived &derived() {
+            return static_cast<Derived &>(*this);
+        }
+
+        const Derived &derived() const {
+            return static_cast<const Derived &>(*this);
+        }
 
-        virtual std::size_t size() const = 0;
+        [[nodiscard]]
+        static constexpr std::size_t size() {
+            return D;
+        }
 
-        virtual R operator[](std::size_t index) = 0;
+        R operator[](std::size_t index) {
+            return derived()[index];
+        }
 
-        virtual CR operator[](std::size_t index) const = 0;
+        CR operator[](std::size_t index) const {
+            return derived()[index];
+        }
 
-        virtual float distance(const IVector<D, T, R, CR> &other) const = 0;
+        float distance(const IVector &other) const {
+            return derived().distance(other.derived());
+        }
 
-        virtual IVector<D, T, R, CR> &invert() = 0;
+        Derived &invert() {
+            return derived().invert();
+        }
 
-        virtual IVector<D, T, R, CR> &invert(int start, int end) = 0;
+        Derived &invert(int start, int end) {
+            return derived().invert(start, end);
+        }
     };
 } // namespace hype
\ No newline at end of file
@@ -0,0 +1,242 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "AssociativeMemory.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hype {
+
+    // Approximate nearest-prototype search over an AssociativeMemory, for memories with many classes.
+    //
+    // Every prototype is hashed into `tables` buckets by the signs of `bits` sparse random projections per table
+    // (sign-random-projection LSH for cosine distance). A query collects the prototypes sharing a bucket with it in any
+    // table, plus those in the buckets reached by flipping each of its `probes` least certain bits. These candidates
+    // are ranked by how many of their bits across all tables agree with the query's, which estimates their angle to
+    // it, and only the best `shortlist` are compared exactly. The cost of a query therefore depends on the bucket
+    // sizes rather than on the number of classes. When no candidates come up, find() falls back to a linear scan.
+    //
+    // The index follows the memory: prototypes modified through its mutable operator[] (as retraining does) are
+    // re-hashed on the next query, and anything that restructures the memory triggers a rebuild. Only one index
+    // should follow a given memory, as it consumes the memory's record of modifications.
+    template<typename T>
+    class LshIndex {
+    private:
+        struct Projection {
+            std::vector<std::uint32_t> dimensions;
+            std::vector<float> signs;
+        };
+
+        template<typename V>
+        float project(const Projection &projection, const V &vector) const {
+            float result = 0;
+            for (std::size_t i = 0; i < projection.dimensions.size(); ++i) {
+                result += projection.signs[i] * static_cast<float>(vector[projection.dimensions[i]]);
+            }
+            return result;
+        }
+
+        // The code of `vector` in `table`, and the margins of its bits when `margins` is given.
+        template<typename V>
+        std::uint32_t code(const V &vector, std::size_t table, std::vector<float> *margins = nullptr) const {
+            std::uint32_t result = 0;
+            for (std::size_t b = 0; b < bits; ++b) {
+                float value = project(projections[table * bits + b], vector);
+                result |= static_cast<std::uint32_t>(value >= 0) << b;
+                if (margins != nullptr) {
+                    (*margins)[b] = std::abs(value);
+                }
+            }
+            return result;
+        }
+
+        void add(std::uint32_t prototype) {
+            for (std::size_t t = 0; t < tables; ++t) {
+                std::uint32_t c = code(std::as_const(*memory)[prototype], t);
+                codes[prototype * tables + t] = c;
+                buckets[t][c].emplace_back(prototype);
+            }
+        }
+
+        void remove(std::uint32_t prototype) {
+            for (std::size_t t = 0; t < tables; ++t) {
+                auto &bucket = buckets[t][codes[prototype * tables + t]];
+                bucket.erase(std::find(bucket.begin(), bucket.end(), prototype));
+            }
+        }
+
+        void rebuild() {
+            buckets.assign(tables, {});
+            codes.assign(memory->size() * tables, 0);
+            seen.assign(memory->size(), 0);
+            for (std::uint32_t i = 0; i < memory->size(); ++i) {
+                add(i);
+            }
+            generation = memory->generation();
+            memory->clear_modified();
+        }
+
+        // Re-hashes what retraining changed since the last query.
+        void refresh() {
+            if (memory->generation() != generation) {
+                rebuild();
+                return;
+            }
+            for (const auto &i: memory->modified()) {
+                remove(i);
+                add(i);
+            }
+            memory->clear_modified();
+        }
+
+    public:
+        // With `bits` zero, every table uses about log2(classes) - 3 bits, so buckets hold around eight prototypes.
+        explicit LshIndex(AssociativeMemory<T> &memory_, std::size_t tables_ = 32, std::size_t bits_ = 0,
+                          std::size_t probes_ = 4, std::size_t shortlist_ = 32, std::size_t nonzeros = 256,
+                          std::uint64_t seed = 0)
+                : memory(&memory_), tables(tables_), probes(probes_), shortlist(std::max<std::size_t>(shortlist_, 1)) {
+            if (bits_ == 0) {
+                auto classes = static_cast<double>(std::max<std::size_t>(memory->size(), 2));
+                bits_ = static_cast<std::size_t>(std::max(1.0, std::round(std::log2(classes)) - 3));
+            }
+            bits = std::min<std::size_t>(bits_, 24);
+            probes = std::min(probes, bits);
+            nonzeros = std::min(nonzeros, T::size());
+
+            for (std::size_t p = 0; p < tables * bits; ++p) {
+                Projection projection;
+                for (std::size_t j = 0; j < nonzeros; ++j) {
+                    std::uint64_t draw = mix(seed, p * nonzeros + j);
+                    projection.dimensions.emplace_back(static_cast<std::uint32_t>((draw >> 1) % T::size()));
+                    projection.signs.emplace_back(draw & 1 ? 1.0f : -1.0f);
+                }
+                projections.emplace_back(std::move(projection));
+            }
+            rebuild();
+        }
+
+        template<typename Q>
+        std::size_t find(const Q &query) {
+            refresh();
+            if (memory->size() == 0) {
+                throw error("Failed to find query in empty associative memory.");
+            }
+
+            ++stamp;
+            found.clear();
+            std::vector<std::uint32_t> query_codes(tables);
+            std::vector<float> margins(bits);
+            std::vector<std::size_t> order(bits);
+            for (std::size_t t = 0; t < tables; ++t) {
+                std::uint32_t c = code(query, t, &margins);
+                query_codes[t] = c;
+                auto lookup = [&](std::uint32_t key) {
+                    auto bucket = buckets[t].find(key);
+                    if (bucket == buckets[t].end()) {
+                        return;
+                    }
+                    for (const auto &i: bucket->second) {
+                        if (seen[i] != stamp) {
+                            seen[i] = stamp;
+                            found.emplace_back(0, i);
+                        }
+                    }
+                };
+                lookup(c);
+
+                std::iota(order.begin(), order.end(), 0);
+                std::partial_sort(order.begin(), order.begin() + probes, order.end(),
+                                  [&](std::size_t a, std::size_t b) { return margins[a] < margins[b]; });
+                for (std::size_t p = 0; p < probes; ++p) {
+                    lookup(c ^ (1u << order[p]));
+                }
+            }
+
+            last_candidates = found.size();
+            if (found.empty()) {
+                last_compared = memory->size();
+                return std::as_const(*memory).find(query);
+            }
+
+            for (auto &[disagreements, i]: found) {
+                for (std::size_t t = 0; t < tables; ++t) {
+                    disagreements += __builtin_popcount(query_codes[t] ^ codes[i * tables + t]);
+                }
+            }
+            if (found.size() > shortlist) {
+                std::nth_element(found.begin(), found.begin() + shortlist, found.end());
+                found.resize(shortlist);
+            }
+            last_compared = found.size();
+
+            std::size_t index = 0;
+            float min_distance = std::numeric_limits<float>::max();
+            for (const auto &[disagreements, i]: found) {
+                float distance = query.distance(std::as_const(*memory)[i]);
+                if (distance < min_distance) {
+                    index = i;
+                    min_distance = distance;
+                }
+            }
+            return index;
+        }
+
+        // Number of prototypes the last find() found in the buckets it probed.
+        [[nodiscard]]
+        std::size_t candidates() const {
+            return last_candidates;
+        }
+
+        // Number of prototypes the last find() computed the exact distance to.
+        [[nodiscard]]
+        std::size_t compared() const {
+            return last_compared;
+        }
+
+    private:
+        AssociativeMemory<T> *memory;
+        std::size_t tables;
+        std::size_t bits;
+        std::size_t probes;
+        std::size_t shortlist;
+        std::vector<Projection> projections;
+        std::vector<std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>> buckets;
+        // Code of prototype i in table t, at i * tables + t.
+        std::vector<std::uint32_t> codes;
+        std::uint64_t generation = 0;
+        std::vector<std::uint64_t> seen;
+        std::uint64_t stamp = 0;
+        // Candidates of the current query, with the number of their bits that disagree with the query's.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> found;
+        std::size_t last_candidates = 0;
+        std::size_t last_compared = 0;
+    };
+
+} // namespace hype
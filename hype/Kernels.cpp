@@ -0,0 +1,496 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Kernels.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HYPE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace hype {
+    namespace {
+        // The bodies are written once and inlined into one wrapper per instruction set, which the compiler then
+        // vectorises for that instruction set.
+#define HYPE_INLINE inline __attribute__((always_inline))
+
+        HYPE_INLINE void add_body(float *out, const float *a, const float *b, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = a[i] + b[i];
+            }
+        }
+
+        HYPE_INLINE void sub_body(float *out, const float *a, const float *b, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = a[i] - b[i];
+            }
+        }
+
+        HYPE_INLINE void mul_body(float *out, const float *a, const float *b, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = a[i] * b[i];
+            }
+        }
+
+        HYPE_INLINE void multiply_add_body(float *__restrict out, const float *__restrict a,
+                                           const float *__restrict b, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] += a[i] * b[i];
+            }
+        }
+
+        HYPE_INLINE void multiply_replace_body(float *__restrict out, const float *__restrict a,
+                                               const float *__restrict from, const float *__restrict to,
+                                               std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] += a[i] * (to[i] - from[i]);
+            }
+        }
+
+        HYPE_INLINE std::uint64_t hamming_body(const std::uint64_t *a, const std::uint64_t *b, std::size_t words) {
+            std::uint64_t result = 0;
+            for (std::size_t i = 0; i < words; ++i) {
+                result += __builtin_popcountll(a[i] ^ b[i]);
+            }
+            return result;
+        }
+
+        HYPE_INLINE std::uint64_t popcount_body(const std::uint64_t *a, std::size_t words) {
+            std::uint64_t result = 0;
+            for (std::size_t i = 0; i < words; ++i) {
+                result += __builtin_popcountll(a[i]);
+            }
+            return result;
+        }
+
+        // Blocked so that a panel of `b` stays in cache while it is multiplied with every row of `a`. Each tile of
+        // GEMM_ROWS rows by one register's worth of columns is summed in registers, so every load from `b` feeds
+        // GEMM_ROWS products. Tiles are GCC vectors of WIDTH floats, only aligned to their elements, as rows of `b` and
+        // `out` start anywhere.
+        constexpr std::size_t GEMM_ROWS = 4;
+        constexpr std::size_t GEMM_COLUMN_BLOCK = 512;
+        constexpr std::size_t GEMM_INNER_BLOCK = 128;
+
+        template<std::size_t WIDTH>
+        using GemmVector __attribute__((vector_size(WIDTH * sizeof(float)), aligned(sizeof(float)))) = float;
+
+        template<std::size_t WIDTH, std::size_t ROWS>
+        HYPE_INLINE void gemm_tile(float *__restrict out, const float *__restrict a, const float *__restrict b,
+                                   std::size_t inner, std::size_t columns, std::size_t k_begin, std::size_t k_end) {
+            using Vector = GemmVector<WIDTH>;
+            Vector sums[ROWS];
+            for (std::size_t r = 0; r < ROWS; ++r) {
+                sums[r] = *reinterpret_cast<const Vector *>(out + r * columns);
+            }
+            for (std::size_t k = k_begin; k < k_end; ++k) {
+                Vector row = *reinterpret_cast<const Vector *>(b + k * columns);
+                for (std::size_t r = 0; r < ROWS; ++r) {
+                    sums[r] += a[r * inner + k] * row;
+                }
+            }
+            for (std::size_t r = 0; r < ROWS; ++r) {
+                *reinterpret_cast<Vector *>(out + r * columns) = sums[r];
+            }
+        }
+
+        template<std::size_t WIDTH>
+        HYPE_INLINE void gemm_body(float *out, const float *a, const float *b, std::size_t rows, std::size_t inner,
+                                   std::size_t columns) {
+            for (std::size_t i = 0; i < rows * columns; ++i) {
+                out[i] = 0;
+            }
+            for (std::size_t j_begin = 0; j_begin < columns; j_begin += GEMM_COLUMN_BLOCK) {
+                std::size_t j_end = std::min(j_begin + GEMM_COLUMN_BLOCK, columns);
+                std::size_t j_tiled = j_begin + (j_end - j_begin) / WIDTH * WIDTH;
+                for (std::size_t k_begin = 0; k_begin < inner; k_begin += GEMM_INNER_BLOCK) {
+                    std::size_t k_end = std::min(k_begin + GEMM_INNER_BLOCK, inner);
+                    for (std::size_t i = 0; i < rows; i += GEMM_ROWS) {
+                        float *o = out + i * columns;
+                        const float *x = a + i * inner;
+                        for (std::size_t j = j_begin; j < j_tiled; j += WIDTH) {
+                            switch (std::min(GEMM_ROWS, rows - i)) {
+                                case 1:
+                                    gemm_tile<WIDTH, 1>(o + j, x, b + j, inner, columns, k_begin, k_end);
+                                    break;
+                                case 2:
+                                    gemm_tile<WIDTH, 2>(o + j, x, b + j, inner, columns, k_begin, k_end);
+                                    break;
+                                case 3:
+                                    gemm_tile<WIDTH, 3>(o + j, x, b + j, inner, columns, k_begin, k_end);
+                                    break;
+                                default:
+                                    gemm_tile<WIDTH, GEMM_ROWS>(o + j, x, b + j, inner, columns, k_begin, k_end);
+                            }
+                        }
+                        // Columns past the last whole tile.
+                        for (std::size_t r = i; r < std::min(i + GEMM_ROWS, rows); ++r) {
+                            for (std::size_t k = k_begin; k < k_end; ++k) {
+                                for (std::size_t j = j_tiled; j < j_end; ++j) {
+                                    out[r * columns + j] += a[r * inner + k] * b[k * columns + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        HYPE_INLINE float finish_distance(double a_dot_b, double a_mag, double b_mag) {
+            return 1.0 - (a_dot_b / (std::sqrt(a_mag) * std::sqrt(b_mag)));
+        }
+
+        template<typename B>
+        HYPE_INLINE float cosine_distance_body(const float *a, const B *b, std::size_t n) {
+            double a_dot_b = 0.0;
+            double a_mag = 0.0;
+            double b_mag = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_mag += static_cast<double>(a[i]) * a[i];
+                b_mag += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_mag, b_mag);
+        }
+
+        float cosine_distance_scalar(const float *a, const float *b, std::size_t n) {
+            return cosine_distance_body(a, b, n);
+        }
+
+        float cosine_distance_i16_scalar(const float *a, const std::int16_t *b, std::size_t n) {
+            return cosine_distance_body(a, b, n);
+        }
+
+#define HYPE_KERNELS(suffix, features, width)                                                                         \
+        __attribute__((target(features))) void add_##suffix(float *out, const float *a, const float *b,          \
+                                                          std::size_t n) {                                     \
+            add_body(out, a, b, n);                                                                            \
+        }                                                                                                      \
+        __attribute__((target(features))) void sub_##suffix(float *out, const float *a, const float *b,          \
+                                                          std::size_t n) {                                     \
+            sub_body(out, a, b, n);                                                                            \
+        }                                                                                                      \
+        __attribute__((target(features))) void mul_##suffix(float *out, const float *a, const float *b,          \
+                                                          std::size_t n) {                                     \
+            mul_body(out, a, b, n);                                                                            \
+        }                                                                                                      \
+        __attribute__((target(features))) void multiply_add_##suffix(float *out, const float *a, const float *b, \
+                                                                   std::size_t n) {                            \
+            multiply_add_body(out, a, b, n);                                                                   \
+        }                                                                                                      \
+        __attribute__((target(features))) void multiply_replace_##suffix(float *out, const float *a,             \
+                                                                       const float *from, const float *to,     \
+                                                                       std::size_t n) {                        \
+            multiply_replace_body(out, a, from, to, n);                                                        \
+        }                                                                                                      \
+        __attribute__((target(features))) std::uint64_t hamming_##suffix(const std::uint64_t *a,                 \
+                                                                       const std::uint64_t *b,                 \
+                                                                       std::size_t words) {                    \
+            return hamming_body(a, b, words);                                                                  \
+        }                                                                                                      \
+        __attribute__((target(features))) std::uint64_t popcount_##suffix(const std::uint64_t *a,               \
+                                                                        std::size_t words) {                   \
+            return popcount_body(a, words);                                                                    \
+        }                                                                                                      \
+        __attribute__((target(features))) void gemm_##suffix(float *out, const float *a, const float *b,         \
+                                                           std::size_t rows, std::size_t inner,                \
+                                                           std::size_t columns) {                              \
+            gemm_body<width>(out, a, b, rows, inner, columns);                                                 \
+        }
+
+        void add_scalar(float *out, const float *a, const float *b, std::size_t n) {
+            add_body(out, a, b, n);
+        }
+
+        void sub_scalar(float *out, const float *a, const float *b, std::size_t n) {
+            sub_body(out, a, b, n);
+        }
+
+        void mul_scalar(float *out, const float *a, const float *b, std::size_t n) {
+            mul_body(out, a, b, n);
+        }
+
+        void multiply_add_scalar(float *out, const float *a, const float *b, std::size_t n) {
+            multiply_add_body(out, a, b, n);
+        }
+
+        void multiply_replace_scalar(float *out, const float *a, const float *from, const float *to, std::size_t n) {
+            multiply_replace_body(out, a, from, to, n);
+        }
+
+        std::uint64_t hamming_scalar(const std::uint64_t *a, const std::uint64_t *b, std::size_t words) {
+            return hamming_body(a, b, words);
+        }
+
+        std::uint64_t popcount_scalar(const std::uint64_t *a, std::size_t words) {
+            return popcount_body(a, words);
+        }
+
+        void gemm_scalar(float *out, const float *a, const float *b, std::size_t rows, std::size_t inner,
+                         std::size_t columns) {
+            gemm_body<4>(out, a, b, rows, inner, columns);
+        }
+
+#ifdef HYPE_X86
+        HYPE_KERNELS(sse42, "sse4.2,popcnt", 4)
+        HYPE_KERNELS(avx2, "avx2,fma,popcnt", 8)
+        HYPE_KERNELS(avx512, "avx512f,avx512bw,avx512vl,popcnt", 16)
+
+        __attribute__((target("sse4.2")))
+        float cosine_distance_sse42(const float *a, const float *b, std::size_t n) {
+            __m128d dot = _mm_setzero_pd(), a_mag = _mm_setzero_pd(), b_mag = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128d va = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i))));
+                __m128d vb = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i))));
+                dot = _mm_add_pd(dot, _mm_mul_pd(va, vb));
+                a_mag = _mm_add_pd(a_mag, _mm_mul_pd(va, va));
+                b_mag = _mm_add_pd(b_mag, _mm_mul_pd(vb, vb));
+            }
+            double d[2], am[2], bm[2];
+            _mm_storeu_pd(d, dot);
+            _mm_storeu_pd(am, a_mag);
+            _mm_storeu_pd(bm, b_mag);
+            double a_dot_b = d[0] + d[1], a_sum = am[0] + am[1], b_sum = bm[0] + bm[1];
+            for (; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_sum += static_cast<double>(a[i]) * a[i];
+                b_sum += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_sum, b_sum);
+        }
+
+        __attribute__((target("sse4.2")))
+        float cosine_distance_i16_sse42(const float *a, const std::int16_t *b, std::size_t n) {
+            return cosine_distance_body(a, b, n);
+        }
+
+        __attribute__((target("avx2,fma")))
+        float cosine_distance_avx2(const float *a, const float *b, std::size_t n) {
+            __m256d dot = _mm256_setzero_pd(), a_mag = _mm256_setzero_pd(), b_mag = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256d va = _mm256_cvtps_pd(_mm_loadu_ps(a + i));
+                __m256d vb = _mm256_cvtps_pd(_mm_loadu_ps(b + i));
+                dot = _mm256_fmadd_pd(va, vb, dot);
+                a_mag = _mm256_fmadd_pd(va, va, a_mag);
+                b_mag = _mm256_fmadd_pd(vb, vb, b_mag);
+            }
+            double d[4], am[4], bm[4];
+            _mm256_storeu_pd(d, dot);
+            _mm256_storeu_pd(am, a_mag);
+            _mm256_storeu_pd(bm, b_mag);
+            double a_dot_b = d[0] + d[1] + d[2] + d[3];
+            double a_sum = am[0] + am[1] + am[2] + am[3];
+            double b_sum = bm[0] + bm[1] + bm[2] + bm[3];
+            for (; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_sum += static_cast<double>(a[i]) * a[i];
+                b_sum += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_sum, b_sum);
+        }
+
+        __attribute__((target("avx2,fma")))
+        float cosine_distance_i16_avx2(const float *a, const std::int16_t *b, std::size_t n) {
+            __m256d dot = _mm256_setzero_pd(), a_mag = _mm256_setzero_pd(), b_mag = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256d va = _mm256_cvtps_pd(_mm_loadu_ps(a + i));
+                __m128i vb16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i));
+                __m256d vb = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(vb16));
+                dot = _mm256_fmadd_pd(va, vb, dot);
+                a_mag = _mm256_fmadd_pd(va, va, a_mag);
+                b_mag = _mm256_fmadd_pd(vb, vb, b_mag);
+            }
+            double d[4], am[4], bm[4];
+            _mm256_storeu_pd(d, dot);
+            _mm256_storeu_pd(am, a_mag);
+            _mm256_storeu_pd(bm, b_mag);
+            double a_dot_b = d[0] + d[1] + d[2] + d[3];
+            double a_sum = am[0] + am[1] + am[2] + am[3];
+            double b_sum = bm[0] + bm[1] + bm[2] + bm[3];
+            for (; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_sum += static_cast<double>(a[i]) * a[i];
+                b_sum += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_sum, b_sum);
+        }
+
+        // GCC's _mm512_cvtps_pd starts from an undefined register, which it then reports as uninitialised.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+        __attribute__((target("avx512f")))
+        float cosine_distance_avx512(const float *a, const float *b, std::size_t n) {
+            __m512d dot = _mm512_setzero_pd(), a_mag = _mm512_setzero_pd(), b_mag = _mm512_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512d va = _mm512_cvtps_pd(_mm256_loadu_ps(a + i));
+                __m512d vb = _mm512_cvtps_pd(_mm256_loadu_ps(b + i));
+                dot = _mm512_fmadd_pd(va, vb, dot);
+                a_mag = _mm512_fmadd_pd(va, va, a_mag);
+                b_mag = _mm512_fmadd_pd(vb, vb, b_mag);
+            }
+            double d[8], am[8], bm[8];
+            _mm512_storeu_pd(d, dot);
+            _mm512_storeu_pd(am, a_mag);
+            _mm512_storeu_pd(bm, b_mag);
+            double a_dot_b = 0.0, a_sum = 0.0, b_sum = 0.0;
+            for (std::size_t lane = 0; lane < 8; ++lane) {
+                a_dot_b += d[lane];
+                a_sum += am[lane];
+                b_sum += bm[lane];
+            }
+            for (; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_sum += static_cast<double>(a[i]) * a[i];
+                b_sum += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_sum, b_sum);
+        }
+
+        __attribute__((target("avx512f,avx2")))
+        float cosine_distance_i16_avx512(const float *a, const std::int16_t *b, std::size_t n) {
+            __m512d dot = _mm512_setzero_pd(), a_mag = _mm512_setzero_pd(), b_mag = _mm512_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512d va = _mm512_cvtps_pd(_mm256_loadu_ps(a + i));
+                __m128i vb16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                __m512d vb = _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(vb16));
+                dot = _mm512_fmadd_pd(va, vb, dot);
+                a_mag = _mm512_fmadd_pd(va, va, a_mag);
+                b_mag = _mm512_fmadd_pd(vb, vb, b_mag);
+            }
+            double d[8], am[8], bm[8];
+            _mm512_storeu_pd(d, dot);
+            _mm512_storeu_pd(am, a_mag);
+            _mm512_storeu_pd(bm, b_mag);
+            double a_dot_b = 0.0, a_sum = 0.0, b_sum = 0.0;
+            for (std::size_t lane = 0; lane < 8; ++lane) {
+                a_dot_b += d[lane];
+                a_sum += am[lane];
+                b_sum += bm[lane];
+            }
+            for (; i < n; ++i) {
+                a_dot_b += static_cast<double>(a[i]) * b[i];
+                a_sum += static_cast<double>(a[i]) * a[i];
+                b_sum += static_cast<double>(b[i]) * b[i];
+            }
+            return finish_distance(a_dot_b, a_sum, b_sum);
+        }
+#pragma GCC diagnostic pop
+#endif
+
+        Kernels kernels_for(Isa isa) {
+            switch (isa) {
+#ifdef HYPE_X86
+                case AVX512:
+                    return {AVX512, cosine_distance_avx512, cosine_distance_i16_avx512, add_avx512, sub_avx512, mul_avx512,
+                            multiply_add_avx512, multiply_replace_avx512, hamming_avx512, popcount_avx512, gemm_avx512};
+                case AVX2:
+                    return {AVX2, cosine_distance_avx2, cosine_distance_i16_avx2, add_avx2, sub_avx2, mul_avx2,
+                            multiply_add_avx2, multiply_replace_avx2, hamming_avx2, popcount_avx2, gemm_avx2};
+                case SSE42:
+                    return {SSE42, cosine_distance_sse42, cosine_distance_i16_sse42, add_sse42, sub_sse42, mul_sse42,
+                            multiply_add_sse42, multiply_replace_sse42, hamming_sse42, popcount_sse42, gemm_sse42};
+#endif
+                default:
+                    return {SCALAR, cosine_distance_scalar, cosine_distance_i16_scalar, add_scalar, sub_scalar, mul_scalar,
+                            multiply_add_scalar, multiply_replace_scalar, hamming_scalar, popcount_scalar, gemm_scalar};
+            }
+        }
+
+        Isa requested_isa() {
+            const char *requested = std::getenv("HYPE_ISA");
+            if (requested == nullptr) {
+                return AVX512;
+            }
+
+            std::string name(requested);
+            if (name == "scalar") {
+                return SCALAR;
+            } else if (name == "sse4.2") {
+                return SSE42;
+            } else if (name == "avx2") {
+                return AVX2;
+            } else if (name == "avx512") {
+                return AVX512;
+            }
+            log_error_nl("Ignoring unknown HYPE_ISA '", name, "'; expected scalar, sse4.2, avx2 or avx512.");
+            return AVX512;
+        }
+
+    } // namespace
+
+    bool supports(Isa isa) {
+        switch (isa) {
+            case SCALAR:
+                return true;
+#ifdef HYPE_X86
+            case SSE42:
+                return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+            case AVX2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && supports(SSE42);
+            case AVX512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                       __builtin_cpu_supports("avx512vl") && supports(AVX2);
+#endif
+            default:
+                return false;
+        }
+    }
+
+    // Selected once, on first use, and never changed afterwards, so every thread may read the kernels without
+    // synchronising.
+    const Kernels &kernels() {
+        static const Kernels selected = []() {
+            Isa isa = requested_isa();
+            while (isa != SCALAR && !supports(isa)) {
+                isa = static_cast<Isa>(isa - 1);
+            }
+            return kernels_for(isa);
+        }();
+        return selected;
+    }
+
+    std::ostream &operator<<(std::ostream &os, Isa isa) {
+        switch (isa) {
+            case SCALAR:
+                os << "SCALAR";
+                break;
+            case SSE42:
+                os << "SSE4.2";
+                break;
+            case AVX2:
+                os << "AVX2";
+                break;
+            case AVX512:
+                os << "AVX-512";
+                break;
+        }
+        return os;
+    }
+} // namespace hype
@@ -0,0 +1,66 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace hype {
+
+    // Instruction set levels the hot kernels are built for. The best one supported by the CPU is picked once, on first
+    // use, unless the HYPE_ISA environment variable (scalar, sse4.2, avx2 or avx512) asks for a lower one; it cannot
+    // be changed afterwards.
+    enum Isa {
+        SCALAR,
+        SSE42,
+        AVX2,
+        AVX512,
+    };
+
+    struct Kernels {
+        Isa isa;
+        // Cosine distance, accumulated in double precision.
+        float (*cosine_distance)(const float *a, const float *b, std::size_t n);
+        // Cosine distance between a float vector and an integer one, e.g. a prototype and a compactly stored sample.
+        float (*cosine_distance_i16)(const float *a, const std::int16_t *b, std::size_t n);
+        void (*add)(float *out, const float *a, const float *b, std::size_t n);
+        void (*sub)(float *out, const float *a, const float *b, std::size_t n);
+        void (*mul)(float *out, const float *a, const float *b, std::size_t n);
+        // out += a * b, i.e. binding and bundling in one pass.
+        void (*multiply_add)(float *out, const float *a, const float *b, std::size_t n);
+        // out += a * (to - from), i.e. rebinding a bundled vector from one vector to another in one pass.
+        void (*multiply_replace)(float *out, const float *a, const float *from, const float *to, std::size_t n);
+        // Number of differing bits.
+        std::uint64_t (*hamming)(const std::uint64_t *a, const std::uint64_t *b, std::size_t words);
+        std::uint64_t (*popcount)(const std::uint64_t *a, std::size_t words);
+        // out = a * b for row-major matrices of rows x inner and inner x columns.
+        void (*gemm)(float *out, const float *a, const float *b, std::size_t rows, std::size_t inner,
+                     std::size_t columns);
+    };
+
+    const Kernels &kernels();
+
+    bool supports(Isa isa);
+
+    std::ostream &operator<<(std::ostream &os, Isa isa);
+
+} // namespace hype
@@ -28,6 +28,8 @@ namespace hype {
     template<typename T>
     class Memory {
     public:
+        using value_type = T;
+
         Memory() = default;
 
         explicit Memory(const std::string &path) {
@@ -69,6 +71,18 @@ namespace hype {
             data.clear();
         }
 
+        // Hash of the serialised contents, i.e. of what save() would write.
+        std::uint64_t hash(std::uint64_t seed = hype::hash("")) const {
+            std::uint64_t result = seed;
+            std::stringstream ss;
+            for (const auto &element: data) {
+                ss.str("");
+                ss << element << "\n";
+                result = hype::hash(ss.str(), result);
+            }
+            return result;
+        }
+
     protected:
         std::vector<T> data;
     };
@@ -0,0 +1,134 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Utils.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace hype {
+
+    // Cyclic rotation (permutation) of a hypervector by `shift` positions, without copying it: element i of the view
+    // is element i - shift of the underlying vector. The vector must outlive the view.
+    template<typename V>
+    class Rotated {
+    public:
+        Rotated(const V &vector_, std::size_t shift_) : vector(&vector_), offset(shift_ % V::size()) {}
+
+        [[nodiscard]]
+        static constexpr std::size_t size() {
+            return V::size();
+        }
+
+        [[nodiscard]]
+        std::size_t shift() const {
+            return offset;
+        }
+
+        decltype(auto) operator[](std::size_t index) const {
+            return (*vector)[index >= offset ? index - offset : index + size() - offset];
+        }
+
+        Rotated rotate(std::size_t by) const {
+            return Rotated(*vector, offset + by % size());
+        }
+
+        V materialize() const {
+            V result(NONE);
+            for (std::size_t i = 0; i < size(); ++i) {
+                result[i] = (*this)[i];
+            }
+            return result;
+        }
+
+    private:
+        const V *vector;
+        std::size_t offset;
+    };
+
+    template<typename V>
+    Rotated<V> rotate(const V &vector, std::size_t shift) {
+        return Rotated<V>(vector, shift);
+    }
+
+    // target += sign * rotate(source, shift), walking both vectors in two contiguous runs.
+    template<typename V>
+    void add_rotated(V &target, const V &source, std::size_t shift, int sign = 1) {
+        constexpr std::size_t D = V::size();
+        shift %= D;
+        for (std::size_t i = shift; i < D; ++i) {
+            target[i] += sign * source[i - shift];
+        }
+        for (std::size_t i = 0; i < shift; ++i) {
+            target[i] += sign * source[i + D - shift];
+        }
+    }
+
+    // Sliding-window n-gram over a stream of hypervectors: after pushing frames e_0 .. e_t, the n-gram is
+    // sum_{j < n} rotate(e_{t-j}, j). Rotating the whole window for every new frame would cost O(n * D); instead the
+    // window is kept un-rotated by t, so each push adds the newest frame and subtracts the oldest one, both rotated
+    // by a fixed amount, and the n-gram itself is handed out as a rotated view. Every push thus costs O(D) for any n.
+    template<typename V>
+    class NGram {
+    public:
+        explicit NGram(std::size_t n_) : n(n_) {
+            if (n == 0) {
+                throw error("An n-gram must span at least one frame.");
+            }
+            window.reserve(n);
+            reset();
+        }
+
+        // Returns the n-gram ending in `frame`. Until n frames have been pushed, it spans the frames seen so far.
+        Rotated<V> push(const V &frame) {
+            constexpr std::size_t D = V::size();
+            std::size_t slot = time % n;
+            if (time >= n) {
+                add_rotated(accumulator, window[slot], D - (time - n) % D, -1);
+                window[slot] = frame;
+            } else {
+                window.emplace_back(frame);
+            }
+            add_rotated(accumulator, frame, D - time % D);
+            return Rotated<V>(accumulator, time++);
+        }
+
+        Rotated<V> current() const {
+            return Rotated<V>(accumulator, time == 0 ? 0 : time - 1);
+        }
+
+        void reset() {
+            window.clear();
+            time = 0;
+            for (std::size_t i = 0; i < V::size(); ++i) {
+                accumulator[i] = 0;
+            }
+        }
+
+    private:
+        std::size_t n;
+        std::size_t time;
+        std::vector<V> window;
+        V accumulator;
+    };
+
+} // namespace hype
@@ -0,0 +1,65 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Kernels.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace hype {
+
+    // Projects F-dimensional inputs to D dimensions by an F x D matrix of random signs. The matrix is a pure function
+    // of the seed, so it is regenerated on construction rather than saved with the model.
+    template<std::size_t F, std::size_t D>
+    class RandomProjection {
+    public:
+        explicit RandomProjection(std::uint64_t seed_ = 0) : seed(seed_), matrix(F * D) {
+            constexpr std::size_t WORDS = (D + 63) / 64;
+            for (std::size_t k = 0; k < F; ++k) {
+                for (std::size_t w = 0; w < WORDS; ++w) {
+                    std::uint64_t signs = mix(seed, k * WORDS + w);
+                    for (std::size_t d = w * 64; d < std::min(D, (w + 1) * 64); ++d) {
+                        matrix[k * D + d] = (signs >> (d % 64)) & 1 ? -1.0f : 1.0f;
+                    }
+                }
+            }
+        }
+
+        // Projects `rows` row-major inputs into `out`, which holds rows x D floats. A single row is a matrix-vector
+        // product and gains little from batching.
+        void project(const float *inputs, std::size_t rows, float *out) const {
+            kernels().gemm(out, inputs, matrix.data(), rows, F, D);
+        }
+
+        [[nodiscard]]
+        std::uint64_t projection_seed() const {
+            return seed;
+        }
+
+    private:
+        std::uint64_t seed;
+        std::vector<float> matrix;
+    };
+
+} // namespace hype
@@ -0,0 +1,60 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Random.h"
+
+namespace hype {
+    namespace {
+        struct ThreadRandom {
+            ThreadRandom() {
+                std::random_device device;
+                reseed((static_cast<std::uint64_t>(device()) << 32) | device());
+            }
+
+            void reseed(std::uint64_t seed_) {
+                seed = seed_;
+                counter = 0;
+                engine.seed(static_cast<std::mt19937::result_type>(mix(seed, ~0ULL)));
+            }
+
+            std::uint64_t seed;
+            std::uint64_t counter;
+            std::mt19937 engine;
+        };
+
+        ThreadRandom &thread_random() {
+            thread_local ThreadRandom random;
+            return random;
+        }
+    } // namespace
+
+    std::mt19937 &random_engine() {
+        return thread_random().engine;
+    }
+
+    std::uint64_t next_seed() {
+        auto &random = thread_random();
+        return mix(random.seed, random.counter++);
+    }
+
+    void seed_thread(std::uint64_t seed) {
+        thread_random().reseed(seed);
+    }
+} // namespace hype
@@ -0,0 +1,90 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+namespace hype {
+
+    // SplitMix64 finaliser. Hashing consecutive counters with it gives a counter-based generator: the i-th draw of a
+    // stream is a pure function of (seed, i), so draws can be made in bulk, in any order and from any thread.
+    inline std::uint64_t mix(std::uint64_t value) {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    inline std::uint64_t mix(std::uint64_t seed, std::uint64_t counter) {
+        return mix(seed ^ mix(counter));
+    }
+
+    // Engine used to seed new hypervectors on the calling thread.
+    std::mt19937 &random_engine();
+
+    // A fresh seed from the calling thread's stream, e.g. for one dropout mask.
+    std::uint64_t next_seed();
+
+    // Makes everything drawn on the calling thread (vector seeding and dropout) reproducible. Threads that are never
+    // seeded start from std::random_device.
+    void seed_thread(std::uint64_t seed);
+
+    // One bit per dimension, set for the dimensions which are kept.
+    template<std::size_t D>
+    using Mask = std::array<std::uint64_t, (D + 63) / 64>;
+
+    // Keeps each dimension with probability 1 - `dropout`, as a pure function of `seed`. At a dropout of 0.5 every draw
+    // yields 64 dimensions; otherwise every draw yields two 32-bit uniforms which are compared against a threshold.
+    template<std::size_t D>
+    Mask<D> dropout_mask(float dropout, std::uint64_t seed) {
+        Mask<D> mask;
+        if (dropout <= 0.0f) {
+            mask.fill(~0ULL);
+        } else if (dropout >= 1.0f) {
+            mask.fill(0);
+        } else if (dropout == 0.5f) {
+            for (std::size_t w = 0; w < mask.size(); ++w) {
+                mask[w] = mix(seed, w);
+            }
+        } else {
+            auto threshold = static_cast<std::uint64_t>(static_cast<double>(dropout) * 4294967296.0);
+            for (std::size_t w = 0; w < mask.size(); ++w) {
+                std::uint64_t word = 0;
+                for (std::size_t b = 0; b < 64; b += 2) {
+                    std::uint64_t draw = mix(seed, w * 32 + b / 2);
+                    word |= static_cast<std::uint64_t>((draw & 0xffffffffULL) >= threshold) << b;
+                    word |= static_cast<std::uint64_t>((draw >> 32) >= threshold) << (b + 1);
+                }
+                mask[w] = word;
+            }
+        }
+        return mask;
+    }
+
+    template<std::size_t D>
+    bool kept(const Mask<D> &mask, std::size_t index) {
+        return (mask[index / 64] >> (index % 64)) & 1ULL;
+    }
+
+} // namespace hype
@@ -0,0 +1,323 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "IVector.h"
+#include "Random.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace hype {
+
+    // Sparse block code: D dimensions split into B blocks of D / B, with exactly one active dimension per block. Only
+    // the B active indices are stored, so binding, bundling and similarity all scale with B rather than with D, which
+    // makes very high dimensional models affordable. Building with HDVR_SPARSE_BLOCKS makes it the vector type of HDVR.
+    template<std::size_t D, std::size_t B>
+    class SparseBlockVector : public IVector<SparseBlockVector<D, B>, D, bool, bool, bool> {
+    private:
+        static_assert(B > 0 && D % B == 0, "SparseBlockVector requires D to be a multiple of the number of blocks B.");
+        static constexpr std::size_t S = D / B;
+        using index_t = std::uint32_t;
+
+        void seed(SeedingStrategy seedingStrategy) {
+            indices.fill(0);
+            if (seedingStrategy == NONE) return;
+
+            std::uniform_int_distribution<index_t> distribution(0, S - 1);
+            for (auto &index: indices) {
+                index = distribution(random_engine());
+            }
+        }
+
+        static std::array<index_t, B> decode(const std::string &str) {
+            std::stringstream stream(str);
+            std::string tmp;
+            std::array<index_t, B> result{};
+            std::size_t i = 0;
+            while (std::getline(stream, tmp, ',')) {
+                if (i >= B) {
+                    throw error("Error decoding sparse vector: more than the expected ", B, " blocks.");
+                }
+                unsigned long index = std::stoul(tmp);
+                if (index >= S) {
+                    throw error("Error decoding sparse vector: index ", index, " exceeds block size ", S, ".");
+                }
+                result[i++] = static_cast<index_t>(index);
+            }
+
+            if (i != B) {
+                throw error("Error decoding sparse vector: found ", i, " blocks where ", B, " were expected.");
+            }
+            return result;
+        }
+
+        // A pseudo-random bit derived from both indices of a block, whichever order they come in, used to break
+        // the tie of bundling two vectors that disagree on that block.
+        static bool tie(index_t one, index_t two, std::size_t block) {
+            std::uint32_t h = std::min(one, two) * 0x9E3779B1u ^ std::max(one, two) * 0x85EBCA77u ^
+                              static_cast<std::uint32_t>(block) * 0xC2B2AE3Du;
+            h ^= h >> 15;
+            h *= 0x2C1B3C6Du;
+            h ^= h >> 12;
+            return h & 1;
+        }
+
+    public:
+        explicit SparseBlockVector(SeedingStrategy seedingStrategy = NONE) {
+            seed(seedingStrategy);
+        }
+
+        explicit SparseBlockVector(const std::string &_data) : indices(decode(_data)) {}
+
+        [[nodiscard]]
+        static constexpr std::size_t size() {
+            return D;
+        }
+
+        [[nodiscard]]
+        static constexpr std::size_t blocks() {
+            return B;
+        }
+
+        // The vector activating, in every block, the dimension with the highest of the D `scores`, e.g. to take a
+        // random projection to a block code.
+        static SparseBlockVector<D, B> strongest(const float *scores) {
+            SparseBlockVector<D, B> result(NONE);
+            for (std::size_t b = 0; b < B; ++b) {
+                result.indices[b] = std::max_element(scores + b * S, scores + (b + 1) * S) - (scores + b * S);
+            }
+            return result;
+        }
+
+        // Whether dimension `index` is active.
+        bool operator[](std::size_t index) {
+            return static_cast<const SparseBlockVector &>(*this)[index];
+        }
+
+        bool operator[](std::size_t index) const {
+            return indices[index / S] == index % S;
+        }
+
+        // The active index within `block`.
+        [[nodiscard]]
+        std::size_t active(std::size_t block) const {
+            return indices[block];
+        }
+
+        // One minus the fraction of blocks in which both vectors activate the same dimension.
+        float distance(const SparseBlockVector<D, B> &other) const {
+            std::size_t overlap = 0;
+            for (std::size_t b = 0; b < B; ++b) {
+                overlap += indices[b] == other.indices[b];
+            }
+            return 1.0f - static_cast<float>(overlap) / B;
+        }
+
+        SparseBlockVector<D, B> &invert() {
+            return invert(0, size());
+        }
+
+        // Moves the active index of every block starting in [start, end) half a block away, which makes these blocks
+        // maximally dissimilar to their previous state.
+        SparseBlockVector<D, B> &invert(int start, int end) {
+            if (start >= end) {
+                throw error("Inverting vector failed because start >= end (", start, " >= ", end, ").");
+            }
+            for (std::size_t b = (start + S - 1) / S; b < B && b * S < static_cast<std::size_t>(end); ++b) {
+                indices[b] = (indices[b] + S / 2) % S;
+            }
+            return *this;
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, const SparseBlockVector<D, B> &v) {
+            for (std::size_t b = 0; b < B; ++b) {
+                os << v.indices[b];
+                if (b != B - 1) {
+                    os << ',';
+                }
+            }
+            return os;
+        }
+
+        friend SparseBlockVector<D, B> invert(const SparseBlockVector<D, B> &vector) {
+            return SparseBlockVector<D, B>(vector).invert();
+        }
+
+        // Bundling: per block, the index activated by most of the vectors.
+        friend SparseBlockVector<D, B> add(const std::vector<SparseBlockVector<D, B>> &vectors) {
+            Accumulator accumulator;
+            for (const auto &vector: vectors) {
+                accumulator.add(vector);
+            }
+            return accumulator.result();
+        }
+
+        // Bundling two vectors: blocks on which they agree are kept, and every other block takes the index of one of
+        // them, picked pseudo-randomly per block, so the result stays about equally similar to both. This is the
+        // update retraining applies to the prototype of the true class.
+        friend SparseBlockVector<D, B> add(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two) {
+            SparseBlockVector<D, B> result(NONE);
+            for (std::size_t b = 0; b < B; ++b) {
+                index_t low = std::min(one.indices[b], two.indices[b]);
+                index_t high = std::max(one.indices[b], two.indices[b]);
+                result.indices[b] = tie(low, high, b) ? high : low;
+            }
+            return result;
+        }
+
+        // Bundles `two` into `one` as a retraining update: every block on which they disagree takes the index of
+        // `two` unless it is dropped, with probability `dropout`. A prototype keeps a single index per block, so a
+        // high dropout stands in for the weight of the many vectors already bundled into it.
+        friend SparseBlockVector<D, B> add(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two,
+                                           float dropout, std::uint64_t seed) {
+            SparseBlockVector<D, B> result(one);
+            auto mask = dropout_mask<B>(dropout, seed);
+            for (std::size_t b = 0; b < B; ++b) {
+                if (kept<B>(mask, b)) {
+                    result.indices[b] = two.indices[b];
+                }
+            }
+            return result;
+        }
+
+        // Removes `two` from `one`: every block on which they agree is moved half a block away, as invert() does,
+        // and the others are kept. This is the update retraining applies to the prototype of a wrong prediction.
+        friend SparseBlockVector<D, B> sub(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two) {
+            return sub(one, two, 0.0f, 0);
+        }
+
+        // As sub(one, two), but each block is dropped from the update with probability `dropout`.
+        friend SparseBlockVector<D, B> sub(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two,
+                                           float dropout, std::uint64_t seed) {
+            SparseBlockVector<D, B> result(one);
+            auto mask = dropout_mask<B>(dropout, seed);
+            for (std::size_t b = 0; b < B; ++b) {
+                if (one.indices[b] == two.indices[b] && kept<B>(mask, b)) {
+                    result.indices[b] = (one.indices[b] + S / 2) % S;
+                }
+            }
+            return result;
+        }
+
+        // Binding: block-wise cyclic shift of one vector's active index by the other's.
+        friend SparseBlockVector<D, B> mul(const std::vector<SparseBlockVector<D, B>> &vectors) {
+            SparseBlockVector<D, B> result(NONE);
+            for (auto const &vector: vectors) {
+                result = mul(result, vector);
+            }
+            return result;
+        }
+
+        friend SparseBlockVector<D, B> mul(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two) {
+            SparseBlockVector<D, B> result(NONE);
+            for (std::size_t b = 0; b < B; ++b) {
+                result.indices[b] = (one.indices[b] + two.indices[b]) % S;
+            }
+            return result;
+        }
+
+        // Bundles vectors one at a time, giving the same result as add(vectors) without holding them all. Each block
+        // counts only the indices that were active in it, and tracks its leader as they are added, so adding a vector
+        // costs O(B) times the number of distinct indices seen per block, and result() costs O(B).
+        class Accumulator {
+        public:
+            void add(const SparseBlockVector<D, B> &vector) {
+                for (std::size_t b = 0; b < B; ++b) {
+                    index_t index = vector.indices[b];
+                    auto &entries = counts[b];
+                    auto entry = std::find_if(entries.begin(), entries.end(),
+                                              [&](const auto &e) { return e.first == index; });
+                    if (entry == entries.end()) {
+                        entry = entries.emplace(entries.end(), index, 0);
+                    }
+                    index_t count = ++entry->second;
+                    if (count > leaders[b].second || (count == leaders[b].second && index < leaders[b].first)) {
+                        leaders[b] = {index, count};
+                    }
+                }
+                ++count;
+            }
+
+            // Takes one vote of `vector` back from each block, so that retraining can move a vector from one
+            // accumulator to another. Indices without votes are left alone, and a block whose leader lost a vote
+            // elects a new one among the indices it has seen.
+            void remove(const SparseBlockVector<D, B> &vector) {
+                for (std::size_t b = 0; b < B; ++b) {
+                    index_t index = vector.indices[b];
+                    auto &entries = counts[b];
+                    auto entry = std::find_if(entries.begin(), entries.end(),
+                                              [&](const auto &e) { return e.first == index; });
+                    if (entry == entries.end() || entry->second == 0) {
+                        continue;
+                    }
+                    --entry->second;
+                    if (leaders[b].first == index) {
+                        leaders[b] = entries.front();
+                        for (const auto &e: entries) {
+                            auto &leader = leaders[b];
+                            if (e.second > leader.second || (e.second == leader.second && e.first < leader.first)) {
+                                leader = e;
+                            }
+                        }
+                    }
+                }
+                count = count > 0 ? count - 1 : 0;
+            }
+
+            void add_product(const SparseBlockVector<D, B> &one, const SparseBlockVector<D, B> &two) {
+                add(mul(one, two));
+            }
+
+            [[nodiscard]]
+            std::size_t size() const {
+                return count;
+            }
+
+            SparseBlockVector<D, B> result() const {
+                SparseBlockVector<D, B> result(NONE);
+                for (std::size_t b = 0; b < B; ++b) {
+                    result.indices[b] = leaders[b].first;
+                }
+                return result;
+            }
+
+        private:
+            std::array<std::vector<std::pair<index_t, index_t>>, B> counts;
+            std::array<std::pair<index_t, index_t>, B> leaders{};
+            std::size_t count = 0;
+        };
+
+    private:
+        std::array<index_t, B> indices;
+    };
+
+    template<typename T>
+    inline constexpr bool is_sparse_block_v = false;
+
+    template<std::size_t D, std::size_t B>
+    inline constexpr bool is_sparse_block_v<SparseBlockVector<D, B>> = true;
+
+} // namespace hype
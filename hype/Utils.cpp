@@ -19,6 +19,7 @@
 
 #include "Utils.h"
 #include <fstream>
+#include <iomanip>
 
 namespace hype {
     bool is_file(const std::string &path) {
@@ -52,6 +53,52 @@ namespace hype {
         }
     }
 
+    void save_file_atomically(const std::string &path, const std::string &data) {
+        std::string temporary = path + ".tmp";
+        std::ofstream file(temporary);
+        if (!file.is_open()) {
+            throw error("Could not open file at path: ", temporary);
+        }
+        file << data;
+        file.close();
+        if (file.fail()) {
+            throw error("Could not write file at path: ", temporary);
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+        if (ec) {
+            throw error("Could not move ", temporary, " to ", path, " (", ec.message(), ")");
+        }
+    }
+
+    void make_directories(const std::string &path) {
+        std::error_code ec;
+        std::filesystem::create_directories(path, ec);
+        if (ec) {
+            throw error("Could not create directory at path: ", path, " (", ec.message(), ")");
+        }
+    }
+
+    std::uint64_t hash(const std::string &data, std::uint64_t seed) {
+        std::uint64_t result = seed;
+        for (const auto &c: data) {
+            result ^= static_cast<unsigned char>(c);
+            result *= 0x100000001b3ULL;
+        }
+        return result;
+    }
+
+    std::uint64_t hash_file(const std::string &path, std::uint64_t seed) {
+        return hash(read_file_directly(path), seed);
+    }
+
+    std::string to_hex(std::uint64_t value) {
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << value;
+        return ss.str();
+    }
+
     std::ostream &operator<<(std::ostream &os, BundlingAction action) {
         switch (action) {
             case DEFAULT:
@@ -22,9 +22,13 @@
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <exception>
 #include <random>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 
 #include "Types.h"
 
@@ -69,6 +73,18 @@ namespace hype {
 
     void save_file_directly(const std::string &path, const std::string &data);
 
+    // Writes `data` next to `path` first and then renames it into place, so `path` only ever holds complete contents.
+    void save_file_atomically(const std::string &path, const std::string &data);
+
+    void make_directories(const std::string &path);
+
+    // 64-bit FNV-1a. Pass a previous result as `seed` to chain several inputs into one hash.
+    std::uint64_t hash(const std::string &data, std::uint64_t seed = 0xcbf29ce484222325ULL);
+
+    std::uint64_t hash_file(const std::string &path, std::uint64_t seed = 0xcbf29ce484222325ULL);
+
+    std::string to_hex(std::uint64_t value);
+
 
     template<typename T>
     std::vector<T> read_file(const std::string &path) {
@@ -85,6 +101,27 @@ namespace hype {
         return result;
     }
 
+    // Streams a file line by line into `callback` instead of reading it into memory first. Reading stops early if
+    // `callback` returns false.
+    template<typename F>
+    void for_each_line(const std::string &path, F &&callback) {
+        if (!is_file(path)) {
+            throw error("The path '", path, "' does not lead to a file.");
+        }
+
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw error("Could not open file at path: ", path);
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!callback(line)) {
+                break;
+            }
+        }
+    }
+
     template<typename T>
     void save_file(const std::string &path, const std::vector<T> &data) {
         std::stringstream ss;
@@ -94,6 +131,45 @@ namespace hype {
         save_file_directly(path, ss.str());
     }
 
+    // Reads and writes the in-memory representation of the elements as is. Much smaller and faster than the text
+    // format, but only readable on the same architecture, so meant for caches rather than for exchange.
+    template<typename T>
+    std::vector<T> read_binary_file(const std::string &path) {
+        static_assert(std::is_trivially_copyable_v<T>, "Binary files hold trivially copyable elements only.");
+        if (!is_file(path)) {
+            throw error("The path '", path, "' does not lead to a file.");
+        }
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            throw error("Could not open file at path: ", path);
+        }
+        std::streamsize bytes = file.tellg();
+        if (bytes % sizeof(T) != 0) {
+            throw error("File at path ", path, " holds ", bytes, " bytes, which is not a whole number of ", sizeof(T),
+                        " byte elements.");
+        }
+
+        std::vector<T> result(bytes / sizeof(T));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char *>(result.data()), bytes)) {
+            throw error("Could not read file at path: ", path);
+        }
+        return result;
+    }
+
+    template<typename T>
+    void save_binary_file(const std::string &path, const std::vector<T> &data) {
+        static_assert(std::is_trivially_copyable_v<T>, "Binary files hold trivially copyable elements only.");
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw error("Could not open file at path: ", path);
+        }
+        if (!file.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(T))) {
+            throw error("Could not write file at path: ", path);
+        }
+    }
+
     std::ostream &operator<<(std::ostream &os, BundlingAction action);
 
     std::ostream &operator<<(std::ostream &os, SeedingStrategy action);
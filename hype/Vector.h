@@ -19,18 +19,22 @@
 
 #pragma once
 
+#include "Bits.h"
 #include "IVector.h"
+#include "Kernels.h"
+#include "Random.h"
 #include "Utils.h"
 
+#include <cmath>
+#include <limits>
 #include <random>
+#include <type_traits>
 
 namespace hype {
 
     template<std::size_t D, typename T>
-    class Vector : public IVector<D, T, T &, const T &> {
+    class Vector : public IVector<Vector<D, T>, D, T, T &, const T &> {
     private:
-        using Vector_t = IVector<D, T, T &, const T &>;
-
         void seed(SeedingStrategy seedingStrategy) {
             std::function<T()> generator = nullptr;
 
@@ -39,19 +43,19 @@ namespace hype {
                     generator = [&]() {
                         std::uniform_int_distribution<> distribution(std::numeric_limits<T>::min(),
                                                                      std::numeric_limits<T>::max());
-                        return distribution(this->random_source);
+                        return distribution(random_engine());
                     };
                     break;
                 case POLAR:
                     generator = [&]() {
                         std::uniform_int_distribution<> distribution(0, 1);
-                        return distribution(this->random_source) ? 1 : -1;
+                        return distribution(random_engine()) ? 1 : -1;
                     };
                     break;
                 case BINARY:
                     generator = [&]() {
                         std::uniform_int_distribution<> distribution(0, 1);
-                        return distribution(this->random_source);
+                        return distribution(random_engine());
                     };
                     break;
                 default:
@@ -69,8 +73,8 @@ namespace hype {
             std::array<T, D> result;
             std::size_t i = 0;
             while (std::getline(stream, tmp, ',')) {
-                if constexpr (std::is_same<int, T>::value) {
-                    result[i] = std::stoi(tmp);
+                if constexpr (std::is_integral<T>::value) {
+                    result[i] = static_cast<T>(std::stoi(tmp));
                 } else if constexpr (std::is_same<float, T>::value) {
                     result[i] = std::stof(tmp);
                 } else {
@@ -87,50 +91,118 @@ namespace hype {
             return result;
         }
 
+        // Converts between element types, rounding and clamping to the range of an integral T.
+        template<typename U>
+        static T convert(U value) {
+            if constexpr (std::is_integral_v<T> && std::is_floating_point_v<U>) {
+                U rounded = std::round(value);
+                if (rounded <= static_cast<U>(std::numeric_limits<T>::min())) {
+                    return std::numeric_limits<T>::min();
+                } else if (rounded >= static_cast<U>(std::numeric_limits<T>::max())) {
+                    return std::numeric_limits<T>::max();
+                }
+                return static_cast<T>(rounded);
+            } else {
+                return static_cast<T>(value);
+            }
+        }
+
+        template<std::size_t, typename>
+        friend class Vector;
+
     public:
         explicit Vector(SeedingStrategy seedingStrategy = NONE) {
             seed(seedingStrategy);
         }
 
+        template<typename U>
+        explicit Vector(const Vector<D, U> &other) {
+            for (std::size_t i = 0; i < D; ++i) {
+                data[i] = convert(other.data[i]);
+            }
+        }
+
         explicit Vector(std::string _data) : data(decode(_data)) {}
 
         explicit Vector(const std::vector<T> &_data) : data(_data) {}
 
         Vector(const std::initializer_list<T> &_data) : data(_data) {}
 
-        Vector(const Vector<D, T> &other) : data(other.data) {}
+        Vector(const Vector<D, T> &other) = default;
+
+        Vector<D, T> &operator=(const Vector<D, T> &other) = default;
 
         [[nodiscard]]
-        std::size_t size() const override {
-            return data.size();
+        static constexpr std::size_t size() {
+            return D;
         }
 
-        T &operator[](std::size_t index) override {
+        T &operator[](std::size_t index) {
             return data[index];
         }
 
-        const T &operator[](std::size_t index) const override {
+        const T &operator[](std::size_t index) const {
             return data[index];
         }
 
-        float distance(const Vector_t &other) const override {
+        float distance(const Vector<D, T> &other) const {
+            if constexpr (std::is_same_v<T, float>) {
+                return kernels().cosine_distance(data.data(), other.data.data(), D);
+            }
+
             // Inspired by: https://www.simonwenkel.com/notes/ai/metrics/cosine_distance.html
             double a_dot_b = 0.0;
             double a_mag = 0;
             double b_mag = 0;
-            for (size_t i = 0; i < other.size(); ++i) {
-                a_dot_b += (data[i] * other[i]);
+            for (size_t i = 0; i < D; ++i) {
+                a_dot_b += (data[i] * other.data[i]);
                 a_mag += (data[i] * data[i]);
-                b_mag += (other[i] * other[i]);
+                b_mag += (other.data[i] * other.data[i]);
             }
             return 1.0 - (a_dot_b / (std::sqrt(a_mag) * std::sqrt(b_mag)));
         }
 
-        Vector<D, T> &invert() override {
+        // Distance to a vector of another element type, e.g. a compactly stored sample and a float prototype.
+        template<typename U>
+        float distance(const Vector<D, U> &other) const {
+            if constexpr (std::is_same_v<T, float> && std::is_same_v<U, std::int16_t>) {
+                return kernels().cosine_distance_i16(data.data(), other.data.data(), D);
+            } else if constexpr (std::is_same_v<T, std::int16_t> && std::is_same_v<U, float>) {
+                return kernels().cosine_distance_i16(other.data.data(), data.data(), D);
+            }
+
+            double a_dot_b = 0.0;
+            double a_mag = 0;
+            double b_mag = 0;
+            for (size_t i = 0; i < D; ++i) {
+                a_dot_b += static_cast<double>(data[i]) * other.data[i];
+                a_mag += static_cast<double>(data[i]) * data[i];
+                b_mag += static_cast<double>(other.data[i]) * other.data[i];
+            }
+            return 1.0 - (a_dot_b / (std::sqrt(a_mag) * std::sqrt(b_mag)));
+        }
+
+        template<typename U>
+        Vector<D, T> &operator+=(const Vector<D, U> &other) {
+            for (std::size_t i = 0; i < D; ++i) {
+                data[i] += other.data[i];
+            }
+            return *this;
+        }
+
+        template<typename U>
+        Vector<D, T> &operator-=(const Vector<D, U> &other) {
+            for (std::size_t i = 0; i < D; ++i) {
+                data[i] -= other.data[i];
+            }
+            return *this;
+        }
+
+        Vector<D, T> &invert() {
             return invert(0, size());
         }
 
-        Vector<D, T> &invert(int start, int end) override {
+        Vector<D, T> &invert(int start, int end) {
             if (start >= end) {
                 throw error("Inverting vector failed because start >= end (", start, " >= ", end, ").");
             }
@@ -155,15 +227,16 @@ namespace hype {
         }
 
         friend Vector<D, T> add(const std::vector<Vector<D, T>> &vectors, float dropout) {
-            Vector<D, T> result(vectors[0]);
-            std::bernoulli_distribution distribution(dropout);
+            return add(vectors, dropout, next_seed());
+        }
 
-            for (int i = 0; i < result.size(); ++i) {
-                if (distribution(result.random_source)) {
-                    continue;
-                }
-                for (int vi = 1; vi < vectors.size(); ++vi) {
-                    result.data[i] += vectors[vi].data[i];
+        // Dropout is drawn as a mask which is a pure function of `seed`, so results are reproducible from any thread.
+        friend Vector<D, T> add(const std::vector<Vector<D, T>> &vectors, float dropout, std::uint64_t seed) {
+            Vector<D, T> result(vectors[0]);
+            auto mask = dropout_mask<D>(dropout, seed);
+            for (std::size_t vi = 1; vi < vectors.size(); ++vi) {
+                for (std::size_t i = 0; i < D; ++i) {
+                    result.data[i] += static_cast<T>(kept<D>(mask, i)) * vectors[vi].data[i];
                 }
             }
             return result;
@@ -180,20 +253,29 @@ namespace hype {
         }
 
         friend Vector<D, T> add(const Vector<D, T> &one, const Vector<D, T> &two, float dropout) {
-            Vector<D, T> result(one);
-            std::bernoulli_distribution distribution(dropout);
+            return add(one, two, dropout, next_seed());
+        }
 
-            for (int i = 0; i < result.size(); ++i) {
-                if (distribution(result.random_source)) {
-                    continue;
-                }
-                result.data[i] = result.data[i] + two.data[i];
+        friend Vector<D, T> add(const Vector<D, T> &one, const Vector<D, T> &two, float dropout, std::uint64_t seed) {
+            Vector<D, T> result(one);
+            auto mask = dropout_mask<D>(dropout, seed);
+            for (std::size_t i = 0; i < D; ++i) {
+                result.data[i] = result.data[i] + static_cast<T>(kept<D>(mask, i)) * two.data[i];
             }
             return result;
         }
 
+        template<typename U, typename = std::enable_if_t<!std::is_same_v<T, U>>>
+        friend Vector<D, T> add(const Vector<D, T> &one, const Vector<D, U> &two) {
+            return Vector<D, T>(one) += two;
+        }
+
         friend Vector<D, T> add(const Vector<D, T> &one, const Vector<D, T> &two) {
             Vector<D, T> result(one);
+            if constexpr (std::is_same_v<T, float>) {
+                kernels().add(result.data.data(), one.data.data(), two.data.data(), D);
+                return result;
+            }
             for (int i = 0; i < result.size(); ++i) {
                 result.data[i] = result.data[i] + two.data[i];
             }
@@ -201,15 +283,16 @@ namespace hype {
         }
 
         friend Vector<D, T> sub(const std::vector<Vector<D, T>> &vectors, float dropout) {
-            Vector<D, T> result(vectors[0]);
-            std::bernoulli_distribution distribution(dropout);
+            return sub(vectors, dropout, next_seed());
+        }
 
-            for (int i = 0; i < result.size(); ++i) {
-                if (distribution(result.random_source)) {
-                    continue;
-                }
-                for (int vi = 1; vi < vectors.size(); ++vi) {
-                    result.data[i] -= vectors[vi].data[i];
+        // Dropout is drawn as a mask which is a pure function of `seed`, so results are reproducible from any thread.
+        friend Vector<D, T> sub(const std::vector<Vector<D, T>> &vectors, float dropout, std::uint64_t seed) {
+            Vector<D, T> result(vectors[0]);
+            auto mask = dropout_mask<D>(dropout, seed);
+            for (std::size_t vi = 1; vi < vectors.size(); ++vi) {
+                for (std::size_t i = 0; i < D; ++i) {
+                    result.data[i] -= static_cast<T>(kept<D>(mask, i)) * vectors[vi].data[i];
                 }
             }
             return result;
@@ -227,20 +310,29 @@ namespace hype {
         }
 
         friend Vector<D, T> sub(const Vector<D, T> &one, const Vector<D, T> &two, float dropout) {
-            Vector<D, T> result(one);
-            std::bernoulli_distribution distribution(dropout);
+            return sub(one, two, dropout, next_seed());
+        }
 
-            for (int i = 0; i < result.size(); ++i) {
-                if (distribution(result.random_source)) {
-                    continue;
-                }
-                result.data[i] = result.data[i] - two.data[i];
+        friend Vector<D, T> sub(const Vector<D, T> &one, const Vector<D, T> &two, float dropout, std::uint64_t seed) {
+            Vector<D, T> result(one);
+            auto mask = dropout_mask<D>(dropout, seed);
+            for (std::size_t i = 0; i < D; ++i) {
+                result.data[i] = result.data[i] - static_cast<T>(kept<D>(mask, i)) * two.data[i];
             }
             return result;
         }
 
+        template<typename U, typename = std::enable_if_t<!std::is_same_v<T, U>>>
+        friend Vector<D, T> sub(const Vector<D, T> &one, const Vector<D, U> &two) {
+            return Vector<D, T>(one) -= two;
+        }
+
         friend Vector<D, T> sub(const Vector<D, T> &one, const Vector<D, T> &two) {
             Vector<D, T> result(one);
+            if constexpr (std::is_same_v<T, float>) {
+                kernels().sub(result.data.data(), one.data.data(), two.data.data(), D);
+                return result;
+            }
             for (int i = 0; i < result.size(); ++i) {
                 result.data[i] = result.data[i] - two.data[i];
             }
@@ -259,22 +351,81 @@ namespace hype {
 
         friend Vector<D, T> mul(const Vector<D, T> &one, const Vector<D, T> &two) {
             Vector<D, T> result(one);
+            if constexpr (std::is_same_v<T, float>) {
+                kernels().mul(result.data.data(), one.data.data(), two.data.data(), D);
+                return result;
+            }
             for (std::size_t i = 0; i < result.size(); ++i) {
                 result.data[i] = result.data[i] * two.data[i];
             }
             return result;
         }
 
+        // Bundles vectors one at a time, giving the same result as add(vectors) without holding them all.
+        class Accumulator {
+        public:
+            Accumulator() {
+                sum.data.fill(T{});
+            }
+
+            // Resumes from `result`, the result of an accumulator that had `count` vectors added.
+            Accumulator(const Vector<D, T> &result, std::size_t count_) : sum(result), count(count_) {}
+
+            template<typename U>
+            void add(const Vector<D, U> &vector) {
+                if constexpr (std::is_same_v<T, float> && std::is_same_v<U, float>) {
+                    kernels().add(sum.data.data(), sum.data.data(), vector.data.data(), D);
+                } else {
+                    sum += vector;
+                }
+                ++count;
+            }
+
+            // Same as add(mul(one, two)) without materialising the bound vector.
+            void add_product(const Vector<D, T> &one, const Vector<D, T> &two) {
+                if constexpr (std::is_same_v<T, float>) {
+                    kernels().multiply_add(sum.data.data(), one.data.data(), two.data.data(), D);
+                } else {
+                    for (std::size_t i = 0; i < D; ++i) {
+                        sum.data[i] += one.data[i] * two.data[i];
+                    }
+                }
+                ++count;
+            }
+
+            // Same as taking back add_product(one, from) and adding add_product(one, to) instead.
+            void replace_product(const Vector<D, T> &one, const Vector<D, T> &from, const Vector<D, T> &to) {
+                if constexpr (std::is_same_v<T, float>) {
+                    kernels().multiply_replace(sum.data.data(), one.data.data(), from.data.data(), to.data.data(), D);
+                } else {
+                    for (std::size_t i = 0; i < D; ++i) {
+                        sum.data[i] += one.data[i] * (to.data[i] - from.data[i]);
+                    }
+                }
+            }
+
+            [[nodiscard]]
+            std::size_t size() const {
+                return count;
+            }
+
+            Vector<D, T> result() const {
+                return sum;
+            }
+
+        private:
+            Vector<D, T> sum;
+            std::size_t count = 0;
+        };
+
     private:
         std::array<T, D> data;
     };
 
     template<std::size_t D>
     class BinaryVector
-            : public IVector<D, bool, typename std::bitset<D>::reference, typename std::bitset<D>::const_reference> {
+            : public IVector<BinaryVector<D>, D, bool, typename Bits<D>::reference, bool> {
     private:
-        using BinaryVector_t = IVector<D, bool, typename std::bitset<D>::reference, typename std::bitset<D>::const_reference>;
-
         void seed(SeedingStrategy seedingStrategy) {
             if (seedingStrategy == NONE) return;
             if (seedingStrategy != BINARY) {
@@ -283,7 +434,7 @@ namespace hype {
 
             std::bernoulli_distribution distribution(0.5);
             for (std::size_t i = 0; i < D; ++i) {
-                data[i] = distribution(this->random_source);
+                data[i] = distribution(random_engine());
             }
         }
 
@@ -328,13 +479,13 @@ namespace hype {
             }
         }
 
-        static std::bitset<D> decode(const std::string &str) {
+        static Bits<D> decode(const std::string &str) {
             if (str.size() * 4 != D) {
                 throw error("Error converting vector to bitset: string is of length ", str.size(), " in hex (",
                             str.size() * 4, " in binary) but expected ", D);
             }
 
-            std::bitset<D> result;
+            Bits<D> result;
             std::string reversed_str(str.rbegin(), str.rend());
             int offset = 0;
             for (const auto &c: reversed_str) {
@@ -347,12 +498,12 @@ namespace hype {
             return result;
         }
 
-        static std::bitset<D> to_bitset(const std::vector<bool> &src) {
+        static Bits<D> to_bitset(const std::vector<bool> &src) {
             if (src.size() != D) {
                 throw error("Error converting vector to bitset: vector is of length ", src.size(), " but expected ", D);
             }
 
-            std::bitset<D> result;
+            Bits<D> result;
             for (std::size_t i = 0; i < src.size(); ++i) {
                 result[i] = src[i];
             }
@@ -373,31 +524,27 @@ namespace hype {
         BinaryVector(const std::initializer_list<bool> &_data) : data(to_bitset(_data)) {}
 
         [[nodiscard]]
-        std::size_t size() const override {
-            return data.size();
+        static constexpr std::size_t size() {
+            return D;
         }
 
-        typename std::bitset<D>::reference operator[](std::size_t index) override {
+        typename Bits<D>::reference operator[](std::size_t index) {
             return data[index];
         }
 
-        typename std::bitset<D>::const_reference operator[](std::size_t index) const override {
+        bool operator[](std::size_t index) const {
             return data[index];
         }
 
-        float distance(const BinaryVector_t &other) const override {
-            int diffs = 0;
-            for (std::size_t i = 0; i < size(); ++i) {
-                diffs += (data[i] != other[i]);
-            }
-            return static_cast<float>(diffs) / size();
+        float distance(const BinaryVector<D> &other) const {
+            return static_cast<float>(kernels().hamming(data.data(), other.data.data(), Bits<D>::WORDS)) / D;
         }
 
-        BinaryVector &invert() override {
+        BinaryVector &invert() {
             return invert(0, size());
         }
 
-        BinaryVector &invert(int start, int end) override {
+        BinaryVector &invert(int start, int end) {
             if (start >= end) {
                 throw error("Inverting vector failed because start >= end (", start, " >= ", end, ").");
             }
@@ -436,18 +583,9 @@ namespace hype {
         }
 
         friend BinaryVector<D> add(const std::vector<BinaryVector<D>> &vectors) {
-            BinaryVector<D> result(NONE);
-            int cutoff = vectors.size() / 2;
-
-            for (int i = 0; i < result.size(); ++i) {
-                int count = 0;
-                for (int vi = 0; vi < vectors.size(); ++vi) {
-                    count += vectors[vi].data[i];
-                }
-                result.data[i] = count > cutoff;
-            }
-
-            return result;
+            Accumulator accumulator;
+            accumulator.add(vectors);
+            return accumulator.result();
         }
 
         friend BinaryVector<D> add(const BinaryVector<D> &one, const BinaryVector<D> &two) {
@@ -484,7 +622,38 @@ namespace hype {
             return result;
         }
 
+        // Bundles vectors one at a time, giving the same majority as add(vectors) without holding them all. The
+        // per-dimension counts are bit-sliced, so adding a vector takes a few word operations per 64 dimensions.
+        class Accumulator {
+        public:
+            void add(const BinaryVector<D> &vector) {
+                counts.add(vector.data);
+            }
+
+            void add(const std::vector<BinaryVector<D>> &vectors) {
+                counts.add(vectors.size(), [&](std::size_t i) -> const Bits<D> & { return vectors[i].data; });
+            }
+
+            void add_product(const BinaryVector<D> &one, const BinaryVector<D> &two) {
+                add(mul(one, two));
+            }
+
+            [[nodiscard]]
+            std::size_t size() const {
+                return counts.size();
+            }
+
+            BinaryVector<D> result() const {
+                BinaryVector<D> result(NONE);
+                result.data = counts.greater_than(counts.size() / 2);
+                return result;
+            }
+
+        private:
+            BitCounts<D> counts;
+        };
+
     private:
-        std::bitset<D> data;
+        Bits<D> data;
     };
 } // namespace hype
\ No newline at end of file
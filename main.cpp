@@ -1,35 +1,719 @@
+#include "Export.h"
 #include "HDVR.h"
+#include "LiveModel.h"
 #include "Model.h"
+#include "Pruning.h"
+#include "StreamingEncoder.h"
+#include "hype/ConcurrentAssociativeMemory.h"
+#include "hype/Kernels.h"
+#include "hype/SparseVector.h"
 #include "hype/Utils.h"
+#include <atomic>
 #include <chrono>
+#include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define MEMORY_PATH             "./memory"
 #define DATASET_PATH            "./dataset"
 #define MEMORY_DATASET_PATH     "./memory/dataset"
+#define CHECKPOINT_PATH         "./memory/checkpoint"
+#define EXPORT_PATH             "./memory/model.h"
+// Memory for encoded samples when streaming them from disk.
+#define STREAM_MEMORY_BUDGET    (64 << 20)
 
 using namespace hype;
 using namespace hdvr;
 using namespace std::chrono;
 
-int main() {
+// Retraining settings compared by `HDVR sweep`.
+std::vector<TrainingOptions> sweep_configurations(int epochs) {
+    std::vector<TrainingOptions> result;
+    for (float dataset_fraction: {0.5f, 1.0f}) {
+        for (float dropout: {0.0f, 0.2f, 0.5f}) {
+            for (float learning_rate: {0.5f, 1.0f}) {
+                TrainingOptions options;
+                options.epochs = epochs;
+                options.dataset_fraction = dataset_fraction;
+                options.dropout = dropout;
+                options.learning_rate = learning_rate;
+                result.emplace_back(options);
+            }
+        }
+    }
+    return result;
+}
+
+// Compares an LshIndex against the linear scan over `classes` random bipolar prototypes, each query being one of them
+// with a fraction `noise` of its components flipped.
+template<std::size_t D>
+void benchmark_index(std::size_t classes, float noise, std::size_t queries = 500) {
+    AssociativeMemory<Vector<D, float>> memory;
+    for (std::size_t c = 0; c < classes; ++c) {
+        memory.insert(Vector<D, float>(POLAR));
+    }
+
+    std::vector<std::pair<Vector<D, float>, std::size_t>> samples;
+    for (std::size_t q = 0; q < queries; ++q) {
+        std::size_t target = mix(1, q) % classes;
+        Vector<D, float> sample(std::as_const(memory)[target]);
+        for (std::size_t d = 0; d < D; ++d) {
+            if (static_cast<float>(mix(2, q * D + d) >> 40) / static_cast<float>(1ULL << 24) < noise) {
+                sample[d] = -sample[d];
+            }
+        }
+        samples.emplace_back(std::move(sample), target);
+    }
+
+    auto start = steady_clock::now();
+    LshIndex<Vector<D, float>> index(memory);
+    float build = duration<float, std::milli>(steady_clock::now() - start).count();
+
+    std::size_t exact = 0;
+    start = steady_clock::now();
+    for (const auto &[sample, target]: samples) {
+        exact += memory.find(sample) == target;
+    }
+    float linear = duration<float, std::micro>(steady_clock::now() - start).count() / queries;
+
+    std::vector<std::size_t> results;
+    std::size_t candidates = 0;
+    start = steady_clock::now();
+    for (const auto &[sample, target]: samples) {
+        results.push_back(index.find(sample));
+        candidates += index.compared();
+    }
+    float indexed = duration<float, std::micro>(steady_clock::now() - start).count() / queries;
+
+    std::size_t agreements = 0;
+    for (std::size_t q = 0; q < queries; ++q) {
+        agreements += results[q] == memory.find(samples[q].first);
+    }
+
+    log_info_nl(classes, " classes, ", noise * 100, "% noise: recall: ", static_cast<float>(agreements) / queries * 100, "%, compared: ",
+                static_cast<float>(candidates) / queries, ", query: ", indexed, "µs indexed vs ", linear,
+                "µs linear, build: ", build, "ms, exact accuracy: ", static_cast<float>(exact) / queries * 100, "%");
+}
+
+// Trains and classifies with sparse block codes of B blocks, whatever Vect is. Samples are encoded by ID-level encoding
+// against item memories of block codes, and half of each class is bundled into its prototype. Retraining then moves
+// every misclassified sample from the accumulator of the predicted class to that of its own, and derives the
+// prototypes from the accumulators again. Returns the test accuracy of the bundled and of the retrained prototypes.
+template<std::size_t L, std::size_t D, std::size_t F, std::size_t B>
+std::pair<float, float> benchmark_sparse(const Dataset<Vector<F, data_t>, int> &train,
+                                         const Dataset<Vector<F, data_t>, int> &test, int epochs) {
+    using Block = SparseBlockVector<D, B>;
+    ContinuousItemMemory<Block> levels(L, D, RANDOM);
+    FrequencyChannelMemory<Block> channels(F, D, RANDOM);
+    auto encode = [&](const Dataset<Vector<F, data_t>, int> &dataset) {
+        std::vector<std::pair<Block, int>> result;
+        for (std::size_t i = 0; i < dataset.size(); ++i) {
+            typename Block::Accumulator accumulator;
+            channels.for_each_channel([&](std::size_t c, const Block &channel) {
+                accumulator.add_product(channel, levels[frequency_bin(dataset[i].first[c], L)]);
+            });
+            result.emplace_back(accumulator.result(), dataset[i].second);
+        }
+        return result;
+    };
+    auto start = steady_clock::now();
+    auto encoded_train = encode(train);
+    auto encoded_test = encode(test);
+    log_info_nl("Sparse block codes of ", B, " blocks: encoded ", train.size() + test.size(), " samples in ",
+                duration<float>(steady_clock::now() - start).count(), "s.");
+
+    std::vector<std::size_t> limits;
+    for (const auto &[sample, label]: encoded_train) {
+        limits.resize(std::max<std::size_t>(limits.size(), label + 1), 0);
+        ++limits[label];
+    }
+    std::vector<typename Block::Accumulator> accumulators(limits.size());
+    for (const auto &[sample, label]: encoded_train) {
+        if (accumulators[label].size() < limits[label] / 2) {
+            accumulators[label].add(sample);
+        }
+    }
+    AssociativeMemory<Block> memory;
+    for (const auto &accumulator: accumulators) {
+        memory.insert(accumulator.result());
+    }
+    auto accuracy = [&]() {
+        std::size_t correct = 0;
+        for (const auto &[sample, label]: encoded_test) {
+            correct += memory.find(sample) == static_cast<std::size_t>(label);
+        }
+        return static_cast<float>(correct) / static_cast<float>(encoded_test.size()) * 100;
+    };
+
+    float bundled = accuracy();
+    std::size_t updates = 0;
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        for (const auto &[sample, label]: encoded_train) {
+            std::size_t prediction = memory.find(sample);
+            if (prediction != static_cast<std::size_t>(label)) {
+                accumulators[prediction].remove(sample);
+                accumulators[label].add(sample);
+                memory[prediction] = accumulators[prediction].result();
+                memory[label] = accumulators[label].result();
+                ++updates;
+            }
+        }
+    }
+    float retrained = accuracy();
+    log_info_nl("Accuracy: ", bundled, "% bundled, ", retrained, "% after ", epochs, " epochs of retraining (", updates,
+                " updates).");
+    return {bundled, retrained};
+}
+
+// Encodes `stream` into sliding-window n-grams for several n, and checks every n-gram against one summed directly from
+// the ID-level encodings of the frames in its window. Also times NGram::push() alone on the encoded frames, which must
+// cost the same for every n once the window is full, so `stream` should be longer than the largest n. Returns whether
+// both checks pass.
+template<std::size_t L, std::size_t D, std::size_t F, SeedingStrategy S>
+bool benchmark_ngrams(HDVR<L, D, F, S> &hdvr, const std::vector<Vector<F, data_t>> &stream) {
+    if constexpr (!std::is_same_v<Vect<D>, Vector<D, data_t>>) {
+        log_error_nl("N-grams need hypervectors whose bundling is a sum.");
+        return false;
+    } else {
+        std::vector<Vect<D>> full;
+        for (const auto &frame: stream) {
+            full.push_back(hdvr.encode(frame));
+        }
+
+        const std::size_t repetitions = 20;
+        std::vector<float> costs;
+        std::size_t mismatches = 0;
+        for (std::size_t n: {1, 4, 16, 64, 256}) {
+            StreamingEncoder<L, D, F, S> encoder(hdvr, n);
+            for (std::size_t t = 0; t < stream.size(); ++t) {
+                Vect<D> ngram = encoder.push(stream[t]).materialize();
+                Vect<D> expected;
+                for (std::size_t d = 0; d < D; ++d) {
+                    expected[d] = 0;
+                }
+                for (std::size_t j = 0; j < n && j <= t; ++j) {
+                    for (std::size_t d = 0; d < D; ++d) {
+                        expected[(d + j) % D] += full[t - j][d];
+                    }
+                }
+                for (std::size_t d = 0; d < D; ++d) {
+                    mismatches += ngram[d] != expected[d];
+                }
+            }
+
+            // The fastest of several passes, as the first ones also warm the caches.
+            NGram<Vect<D>> ngram(n);
+            float cost = std::numeric_limits<float>::max();
+            for (std::size_t r = 0; r < repetitions; ++r) {
+                ngram.reset();
+                auto start = steady_clock::now();
+                for (const auto &encoded: full) {
+                    ngram.push(encoded);
+                }
+                cost = std::min(cost, duration<float, std::micro>(steady_clock::now() - start).count() / full.size());
+            }
+            costs.push_back(cost);
+            log_info_nl(n, "-grams: ", cost, "µs per frame, ", mismatches, " components differ so far.");
+        }
+
+        // Timing noise aside, a cost growing with n would show as a multiple of the cost at n = 1.
+        const float tolerance = 2.0f;
+        bool flat = *std::max_element(costs.begin(), costs.end()) <= tolerance * costs.front();
+        if (!flat) {
+            log_error_nl("The cost of an n-gram update grows with n.");
+        }
+        return mismatches == 0 && flat;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    bool sweep = mode == "sweep";
+    bool stream = mode == "stream";
+
     const int frequency_points = 617;
     const int level = 100;
     const int dimensions = 5000;
     const int epochs = 10;
     const SeedingStrategy seedingStrategy = POLAR;
 
+    log_info_nl("Using ", kernels().isa, " kernels.");
+
     Model<level, dimensions, frequency_points, seedingStrategy> model;
     HDVR hdvr(model);
+    hdvr.record_latency(true);
 
     if (!model.load(MEMORY_PATH)) {
         hype::log_info_nl("No model could be loaded; continuing with untrained model.");
     }
 
-    if (!hdvr.load_datasets(MEMORY_DATASET_PATH)) {
-        hdvr.load_datasets(DATASET_PATH);
-        hdvr.save_datasets(MEMORY_DATASET_PATH);
+    // Exports the saved model rather than one rebundled from the datasets, and checks the static engine against HDVR on
+    // the raw test samples. That the engine classifies without allocating is checked by StaticEngineTest, which
+    // builds against the exported header.
+    if (mode == "export") {
+        PackedModel<level, dimensions, frequency_points> packed;
+        try {
+            export_model(model, EXPORT_PATH, "hdvr_model");
+            packed = pack(model);
+        } catch (std::runtime_error &e) {
+            log_error_nl("Failed to export model: ", e.what());
+            return 1;
+        }
+        log_info_nl("Exported model to ", EXPORT_PATH, ".");
+
+        auto engine = packed.engine();
+        std::size_t agreements = 0;
+        std::size_t samples = 0;
+        for_each_line(DATASET_PATH "/./test.csv", [&](const std::string &line) {
+            Vector<frequency_points, data_t> sample(line);
+            std::array<data_t, frequency_points> frequencies;
+            for (std::size_t i = 0; i < frequency_points; ++i) {
+                frequencies[i] = sample[i];
+            }
+            agreements += engine.classify(frequencies.data()) == static_cast<std::size_t>(hdvr.classify(sample));
+            ++samples;
+            return true;
+        });
+        log_info_nl("Static engine agrees with HDVR on ", agreements, " of ", samples, " test samples.");
+        return agreements == samples ? 0 : 1;
+    }
+
+    // Prunes the channels least informative by each score, with and without those redundant with better ones, and
+    // compares the encoding time on the raw training set and the test accuracy after training against those of the
+    // full set of channels.
+    if (mode == "prune") {
+        Dataset<Vector<frequency_points, data_t>, int> raw(DATASET_PATH "/./train.csv",
+                                                         DATASET_PATH "/./train_labels.csv");
+        auto evaluate = [&](const std::vector<bool> &mask) -> std::optional<std::pair<float, float>> {
+            model.frequencyChannelMemory.mask(mask);
+            HDVR candidate(model);
+            auto start = steady_clock::now();
+            candidate.encode(raw);
+            float seconds = duration<float>(steady_clock::now() - start).count();
+
+            if (!candidate.load_datasets(DATASET_PATH, MEMORY_DATASET_PATH)) {
+                return std::nullopt;
+            }
+            TrainingOptions options;
+            options.epochs = epochs;
+            return std::make_pair(seconds, candidate.train(options).last_accuracy().value_or(0));
+        };
+
+        auto full = evaluate({});
+        if (!full) {
+            log_error_nl("Could not load datasets from ", DATASET_PATH);
+            return 1;
+        }
+        log_info_nl("All ", frequency_points, " channels: encoded in ", full->first, "s, accuracy: ", full->second, "%");
+        // Channels correlated more strongly than this with a better one are dropped as redundant.
+        const float max_correlation = 0.9f;
+        for (ChannelScore score: {VARIANCE, MUTUAL_INFORMATION}) {
+            auto scores = score_channels(raw, score);
+            for (bool decorrelated: {false, true}) {
+                for (std::size_t keep: {500, 300, 150, 75}) {
+                    auto mask = decorrelated ? channel_mask(raw, scores, keep, max_correlation)
+                                             : channel_mask(scores, keep);
+                    auto pruned = evaluate(mask);
+                    if (!pruned) {
+                        log_error_nl("Could not load datasets from ", DATASET_PATH);
+                        return 1;
+                    }
+                    log_info_nl(std::count(mask.begin(), mask.end(), true), " channels by ", score,
+                                decorrelated ? " without correlated channels" : "", ": encoded in ", pruned->first,
+                                "s (", full->first / pruned->first, "x faster), accuracy: ", pruned->second, "% (",
+                                pruned->second - full->second, " points)");
+                }
+            }
+        }
+        model.frequencyChannelMemory.mask({});
+        return 0;
+    }
+
+    // Trains sparse block codes ten times as wide as the dense model, in blocks of 20 dimensions, and classifies the
+    // test set with them. Fails unless they classify better than chance.
+    if (mode == "sparse") {
+        Dataset<Vector<frequency_points, data_t>, int> train(DATASET_PATH "/./train.csv",
+                                                           DATASET_PATH "/./train_labels.csv");
+        Dataset<Vector<frequency_points, data_t>, int> test(DATASET_PATH "/./test.csv",
+                                                          DATASET_PATH "/./test_labels.csv");
+        auto [bundled, retrained] =
+                benchmark_sparse<level, dimensions * 10, frequency_points, dimensions / 2>(train, test, epochs);
+        std::size_t classes = 0;
+        for (std::size_t i = 0; i < train.size(); ++i) {
+            classes = std::max<std::size_t>(classes, train[i].second + 1);
+        }
+        if (bundled <= 100.0f / classes) {
+            log_error_nl("Sparse block codes classify no better than chance (", 100.0f / classes, "%).");
+            return 1;
+        }
+        if (retrained < bundled) {
+            log_error_nl("Retraining lowered the accuracy of sparse block codes below the bundled ", bundled, "%.");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Compares the bound-pair encoder against the ID-level encoder on the raw training set: XORing every pair per
+    // sample, then with all pairs in the table filled lazily, once more filled, after filling it up front, with a
+    // quarter of the pairs admitted, and with the table built before the model was loaded. Fails on any difference.
+    if (mode == "bound") {
+        Dataset<Vector<frequency_points, data_t>, int> raw(DATASET_PATH "/./train.csv",
+                                                         DATASET_PATH "/./train_labels.csv");
+        auto start = steady_clock::now();
+        auto reference = hdvr.encode(raw);
+        float id_level = duration<float>(steady_clock::now() - start).count();
+        log_info_nl("ID-level: encoded ", raw.size(), " samples in ", id_level, "s.");
+
+        auto run = [&](HDVR<level, dimensions, frequency_points, seedingStrategy> &candidate, const char *name) {
+            auto start = steady_clock::now();
+            auto encoded = candidate.encode(raw);
+            float seconds = duration<float>(steady_clock::now() - start).count();
+            std::size_t mismatches = 0;
+            for (std::size_t i = 0; i < raw.size(); ++i) {
+                for (std::size_t d = 0; d < dimensions; ++d) {
+                    mismatches += encoded[i].first[d] != reference[i].first[d];
+                }
+            }
+            log_info_nl(name, ": ", seconds, "s (", id_level / seconds, "x), ", mismatches,
+                        " components differ from ID-level.");
+            return mismatches;
+        };
+        std::size_t mismatches = 0;
+
+        HDVR xored(model, BOUND_PAIRS);
+        mismatches += run(xored, "Pairs XORed per sample");
+
+        HDVR lazy(model, BOUND_PAIRS);
+        lazy.bound_pairs().limit(std::numeric_limits<std::size_t>::max(), raw);
+        log_info_nl("Table of ", lazy.bound_pairs().size(), " pairs, ", lazy.bound_pairs().bytes() >> 20, " MiB.");
+        mismatches += run(lazy, "Table filled lazily");
+        mismatches += run(lazy, "Table filled");
+
+        HDVR eager(model, BOUND_PAIRS);
+        eager.bound_pairs().limit(std::numeric_limits<std::size_t>::max(), raw);
+        start = steady_clock::now();
+        eager.bound_pairs().fill();
+        log_info_nl("Filled up front in ", duration<float>(steady_clock::now() - start).count(), "s.");
+        mismatches += run(eager, "Table filled up front");
+
+        HDVR limited(model, BOUND_PAIRS);
+        limited.bound_pairs().limit(eager.bound_pairs().bytes() / 4, raw);
+        limited.bound_pairs().fill();
+        log_info_nl("Limited to the ", limited.bound_pairs().size(), " most used pairs.");
+        mismatches += run(limited, "Quarter of the pairs in the table");
+
+        // An HDVR built before its model was loaded packs the loaded item memories once it encodes.
+        Model<level, dimensions, frequency_points, seedingStrategy> reloaded_model;
+        HDVR reloaded(reloaded_model, BOUND_PAIRS);
+        reloaded_model.load(MEMORY_PATH);
+        mismatches += run(reloaded, "Table built before loading the model");
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    // Streams synthetic frames, each changing a given fraction of the channels of the one before to random values, and
+    // compares encoding each in full against encoding it as a delta from the one before.
+    if (mode == "delta") {
+        const std::size_t frames = 200;
+        for (float fraction: {0.01f, 0.05f, 0.1f, 0.25f, 0.5f}) {
+            std::vector<Vector<frequency_points, data_t>> stream;
+            Vector<frequency_points, data_t> frame;
+            for (std::size_t i = 0; i < frequency_points; ++i) {
+                frame[i] = 0;
+            }
+            for (std::size_t f = 0; f < frames; ++f) {
+                for (std::size_t c = 0; c < frequency_points; ++c) {
+                    if (static_cast<float>(mix(f, c) >> 40) / static_cast<float>(1ULL << 24) < fraction) {
+                        frame[c] = static_cast<float>(mix(f + frames, c) >> 40) / static_cast<float>(1ULL << 23) - 1.0f;
+                    }
+                }
+                stream.push_back(frame);
+            }
+
+            std::vector<Vect<dimensions>> full;
+            auto start = steady_clock::now();
+            for (const auto &f: stream) {
+                full.push_back(hdvr.encode(f));
+            }
+            float full_time = duration<float, std::micro>(steady_clock::now() - start).count() / frames;
+
+            std::vector<int> bins;
+            Vect<dimensions> encoded;
+            std::size_t changed = 0;
+            std::size_t mismatches = 0;
+            float delta_time = 0;
+            for (std::size_t f = 0; f < frames; ++f) {
+                start = steady_clock::now();
+                std::size_t n = hdvr.encode_delta(stream[f], bins, encoded);
+                delta_time += duration<float, std::micro>(steady_clock::now() - start).count();
+                changed += f > 0 ? n : 0;
+                for (std::size_t d = 0; d < dimensions; ++d) {
+                    mismatches += encoded[d] != full[f][d];
+                }
+            }
+            log_info_nl(fraction * 100, "% of channels changed per frame (", static_cast<float>(changed) / (frames - 1),
+                        " bins): ", full_time, "µs full vs ", delta_time / frames, "µs delta, ", mismatches,
+                        " components differ.");
+        }
+        return 0;
+    }
+
+    // Checks sliding-window n-grams over synthetic frames, each changing 5% of the channels of the one before.
+    if (mode == "ngram") {
+        const std::size_t frames = 1000;
+        std::vector<Vector<frequency_points, data_t>> stream;
+        Vector<frequency_points, data_t> frame;
+        for (std::size_t i = 0; i < frequency_points; ++i) {
+            frame[i] = 0;
+        }
+        for (std::size_t f = 0; f < frames; ++f) {
+            for (std::size_t c = 0; c < frequency_points; ++c) {
+                if (static_cast<float>(mix(f, c) >> 40) / static_cast<float>(1ULL << 24) < 0.05f) {
+                    frame[c] = static_cast<float>(mix(f + frames, c) >> 40) / static_cast<float>(1ULL << 23) - 1.0f;
+                }
+            }
+            stream.push_back(frame);
+        }
+        return benchmark_ngrams(hdvr, stream) ? 0 : 1;
+    }
+
+    // Compares the encoders: encoding throughput on the raw training set, and test accuracy after training on the
+    // encodings of each.
+    if (mode == "projection") {
+        Dataset<Vector<frequency_points, data_t>, int> raw(DATASET_PATH "/./train.csv",
+                                                         DATASET_PATH "/./train_labels.csv");
+        for (Encoder encoder: {ID_LEVEL, RANDOM_PROJECTION}) {
+            HDVR candidate(model, encoder);
+            auto start = steady_clock::now();
+            auto encoded = candidate.encode(raw);
+            float seconds = duration<float>(steady_clock::now() - start).count();
+
+            if (!candidate.load_datasets(DATASET_PATH, MEMORY_DATASET_PATH)) {
+                log_error_nl("Could not load datasets from ", DATASET_PATH);
+                return 1;
+            }
+            TrainingOptions options;
+            options.epochs = epochs;
+            Metrics metrics = candidate.train(options);
+            log_info_nl(encoder, " encoder: encoded ", encoded.size(), " samples in ", seconds, "s (",
+                        seconds * 1e6f / encoded.size(), "µs per sample), accuracy: ",
+                        metrics.last_accuracy().value_or(0), "%");
+        }
+        return 0;
+    }
+
+    // Serves the saved model to reader threads while saving it over and over, and compares the cost of a query against
+    // classifying on the model directly. Fails unless the served model picked up the saved versions.
+    if (mode == "serve") {
+        std::vector<Vector<frequency_points, data_t>> samples;
+        for_each_line(DATASET_PATH "/./test.csv", [&](const std::string &line) {
+            samples.emplace_back(line);
+            return true;
+        });
+        if (samples.empty()) {
+            log_error_nl("Could not load test samples from ", DATASET_PATH);
+            return 1;
+        }
+
+        std::unique_ptr<LiveModel<level, dimensions, frequency_points, seedingStrategy>> live;
+        try {
+            live = std::make_unique<LiveModel<level, dimensions, frequency_points, seedingStrategy>>(
+                    MEMORY_PATH, milliseconds(50));
+        } catch (std::runtime_error &e) {
+            log_error_nl("Failed to serve model: ", e.what());
+            return 1;
+        }
+
+        hdvr.record_latency(false);
+        auto start = steady_clock::now();
+        for (const auto &sample: samples) {
+            hdvr.classify(sample);
+        }
+        float direct = duration<float, std::micro>(steady_clock::now() - start).count() / samples.size();
+        start = steady_clock::now();
+        for (const auto &sample: samples) {
+            live->classify(sample);
+        }
+        float served = duration<float, std::micro>(steady_clock::now() - start).count() / samples.size();
+
+        const std::size_t acquisitions = 1000000;
+        start = steady_clock::now();
+        for (std::size_t i = 0; i < acquisitions; ++i) {
+            auto snapshot = live->snapshot();
+        }
+        float acquire = duration<float, std::nano>(steady_clock::now() - start).count() / acquisitions;
+        log_info_nl("Query: ", served, "µs served vs ", direct, "µs direct, snapshot: ", acquire, "ns.");
+
+        std::atomic<bool> running{true};
+        std::atomic<std::size_t> queries{0};
+        std::vector<std::thread> readers;
+        for (std::size_t r = 0; r < std::max(2u, std::thread::hardware_concurrency()); ++r) {
+            readers.emplace_back([&, r]() {
+                for (std::size_t i = r; running.load(std::memory_order_relaxed); ++i) {
+                    live->classify(samples[i % samples.size()]);
+                    queries.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        std::size_t saves = 0;
+        auto deadline = steady_clock::now() + seconds(3);
+        while (steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(milliseconds(200));
+            saves += model.save(MEMORY_PATH);
+        }
+        // Loading a version takes a while, so the last one saved gets some time to be picked up.
+        deadline = steady_clock::now() + seconds(10);
+        while (live->version() == 0 && steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(milliseconds(50));
+        }
+        running = false;
+        for (auto &reader: readers) {
+            reader.join();
+        }
+
+        log_info_nl("Served ", queries.load(), " queries on ", readers.size(), " threads across ", live->version() + 1,
+                    " versions.");
+        log_info_nl("Reload latency: ", live->load_latency().summary());
+        log_info_nl("Grace periods: ", live->grace_periods().summary());
+        if (saves == 0 || live->version() == 0) {
+            log_error_nl("Saved ", saves, " versions, but served only the first.");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Measures query and update throughput on a ConcurrentAssociativeMemory holding the saved prototypes, for several
+    // shares of updates among the operations. Updates add a test sample to its class and later take it away again, so
+    // the prototypes stay as saved.
+    if (mode == "concurrent") {
+        Dataset<Vector<frequency_points, data_t>, int> raw(DATASET_PATH "/./test.csv",
+                                                         DATASET_PATH "/./test_labels.csv");
+        if (raw.size() == 0 || model.associativeMemory.size() == 0) {
+            log_error_nl("Needs a saved model and test samples.");
+            return 1;
+        }
+        auto samples = hdvr.encode(raw);
+
+        auto start = steady_clock::now();
+        for (std::size_t i = 0; i < samples.size(); ++i) {
+            model.associativeMemory.find(samples[i].first);
+        }
+        float unsynchronised = samples.size() / duration<float>(steady_clock::now() - start).count();
+        log_info_nl("Unsynchronised: ", unsynchronised, " queries/s on one thread.");
+
+        std::size_t threads = std::max(2u, std::thread::hardware_concurrency());
+        for (float updates: {0.0f, 0.01f, 0.1f, 0.5f}) {
+            ConcurrentAssociativeMemory<Vect<dimensions>> memory(model.associativeMemory);
+            std::atomic<bool> running{true};
+            std::atomic<std::size_t> reads{0};
+            std::atomic<std::size_t> writes{0};
+            std::vector<std::thread> workers;
+            for (std::size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    std::vector<std::size_t> added;
+                    for (std::size_t i = 0; running.load(std::memory_order_relaxed); ++i) {
+                        std::size_t sample = mix(t, i) % samples.size();
+                        const auto &[vector, label] = samples[sample];
+                        if (static_cast<float>(mix(t + threads, i) >> 40) / static_cast<float>(1ULL << 24) >= updates) {
+                            memory.find(vector);
+                            reads.fetch_add(1, std::memory_order_relaxed);
+                        } else if (added.empty() || i % 2 == 0) {
+                            memory.add(label, vector);
+                            added.push_back(sample);
+                            writes.fetch_add(1, std::memory_order_relaxed);
+                        } else {
+                            memory.sub(samples[added.back()].second, samples[added.back()].first);
+                            added.pop_back();
+                            writes.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                    for (auto sample: added) {
+                        memory.sub(samples[sample].second, samples[sample].first);
+                    }
+                });
+            }
+            start = steady_clock::now();
+            std::this_thread::sleep_for(seconds(2));
+            running = false;
+            for (auto &worker: workers) {
+                worker.join();
+            }
+            float elapsed = duration<float>(steady_clock::now() - start).count();
+            log_info_nl(updates * 100, "% updates on ", threads, " threads: ", reads.load() / elapsed,
+                        " queries/s, ", writes.load() / elapsed, " updates/s.");
+        }
+        return 0;
+    }
+
+    bool loaded = stream ? hdvr.stream_datasets(DATASET_PATH, MEMORY_DATASET_PATH, STREAM_MEMORY_BUDGET)
+                         : hdvr.load_datasets(DATASET_PATH, MEMORY_DATASET_PATH);
+    if (!loaded) {
+        log_error_nl("Could not load datasets from ", DATASET_PATH);
+        return 1;
+    }
+
+    if (mode == "index") {
+        LshIndex<Vect<dimensions>> index(model.associativeMemory);
+        auto [recall, candidates] = hdvr.index_recall(index);
+        log_info_nl("Index recall on the test set: ", recall, "%, comparing against ", candidates * 100,
+                    "% of the prototypes.");
+        for (std::size_t classes: {1000, 4000, 16000}) {
+            for (float noise: {0.2f, 0.3f}) {
+                benchmark_index<dimensions>(classes, noise);
+            }
+        }
+        return 0;
+    }
+
+    // Trains with every epoch split into shards, once in forked worker processes while checkpointing and once in this
+    // process, from prototypes bundled from half of each class so that there is something to retrain, and fails
+    // unless both end with the same prototypes.
+    if (mode == "shards") {
+        auto initial = model.associativeMemory;
+        TrainingOptions options;
+        options.epochs = epochs;
+        options.dataset_fraction = 0.5;
+        options.shards = 4;
+        options.shard_processes = false;
+        hdvr.train(options);
+        auto in_process = model.associativeMemory;
+
+        model.associativeMemory = initial;
+        options.shard_processes = true;
+        options.checkpoint_path = CHECKPOINT_PATH "/./shards";
+        options.checkpoint_interval = 1;
+        hdvr.train(options);
+
+        std::size_t differences = 0;
+        for (std::size_t c = 0; c < in_process.size(); ++c) {
+            for (std::size_t d = 0; d < dimensions; ++d) {
+                differences += std::as_const(model.associativeMemory)[c][d] != std::as_const(in_process)[c][d];
+            }
+        }
+        log_info_nl("Worker processes and a single process differ in ", differences, " prototype components.");
+        return differences == 0 ? 0 : 1;
+    }
+
+    if (sweep) {
+        auto start = steady_clock::now();
+        auto results = hdvr.sweep(sweep_configurations(epochs));
+        log_info_nl("Swept ", results.size(), " configurations in ",
+                    duration<float>(steady_clock::now() - start).count(), "s.");
+        for (auto &metrics: results) {
+            metrics.save("./experiments", "sweep");
+        }
+        return 0;
+    }
+
+    TrainingOptions options;
+    options.epochs = decltype(hdvr)::retrainable ? epochs : 0;
+    if (!stream) {
+        options.checkpoint_path = CHECKPOINT_PATH;
+        options.checkpoint_interval = 2;
     }
-    Metrics metrics = hdvr.train(epochs);
+    options.resume = mode == "resume";
+    Metrics metrics = hdvr.train(options);
     log_info_nl("=== SUCCESS ===");
 
     metrics.save("./experiments", "experiment");
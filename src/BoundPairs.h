@@ -0,0 +1,224 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Dataset.h"
+#include "Frequency.h"
+#include "Model.h"
+#include "Types.h"
+#include "hype/Bits.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace hdvr {
+
+    // Every sample of the ID-level encoder bundles bound pairs FCM[channel] * CIM[bin], of which there are only
+    // channels x levels distinct ones. With bipolar item memories each pair is the XOR of the packed channel and level
+    // vector, and encode() bundles a sample by counting bits across its pairs instead of multiplying. The encodings
+    // are identical to the ID-level encoder's.
+    //
+    // Pairs are XORed per sample from the packed item memories, which stay in cache. limit() admits pairs into a
+    // table instead, filled on first use or up front by fill(), but at 37 MiB for all of ISOLET's pairs its lookups
+    // miss the cache and lose to the XOR, so no pairs are admitted by default. The item memories are packed at
+    // construction, and packed again by refresh() once their hashes change.
+    template<std::size_t L, std::size_t D, std::size_t F>
+    class BoundPairTable {
+    private:
+        static constexpr std::int32_t NOT_ADMITTED = -1;
+
+        template<typename Memory>
+        static std::vector<hype::Bits<D>> pack(const Memory &memory) {
+            std::vector<hype::Bits<D>> result(memory.size());
+            for (std::size_t i = 0; i < memory.size(); ++i) {
+                for (std::size_t d = 0; d < D; ++d) {
+                    if (memory[i][d] == -1) {
+                        result[i][d] = true;
+                    } else if (memory[i][d] != 1) {
+                        throw hype::error("Cannot pack item memory with component ", memory[i][d], "; it must be bipolar.");
+                    }
+                }
+            }
+            return result;
+        }
+
+    public:
+        template<hype::SeedingStrategy S>
+        explicit BoundPairTable(const Model<L, D, F, S> &model)
+                : channel_memory(model.frequencyChannelMemory), level_memory(model.continuousItemMemory),
+                  channels(pack(channel_memory)), levels(pack(level_memory)), packed(memories_hash()) {
+            admit({});
+        }
+
+        BoundPairTable(const BoundPairTable &) = delete;
+
+        BoundPairTable &operator=(const BoundPairTable &) = delete;
+
+        // Admits as many pairs as fit in `memory_budget` bytes into the table, preferring those that occur most often
+        // in `dataset`. Drops everything filled so far, and must not run alongside encode().
+        void limit(std::size_t memory_budget, const Dataset<hype::Vector<F, data_t>, int> &dataset) {
+            std::vector<std::size_t> uses(channels.size() * levels.size(), 0);
+            for (std::size_t i = 0; i < dataset.size(); ++i) {
+                for (std::size_t c = 0; c < channels.size(); ++c) {
+                    ++uses[c * levels.size() + frequency_bin(dataset[i].first[c], levels.size())];
+                }
+            }
+
+            std::vector<std::size_t> pairs(uses.size());
+            std::iota(pairs.begin(), pairs.end(), 0);
+            std::stable_sort(pairs.begin(), pairs.end(), [&](std::size_t a, std::size_t b) {
+                return uses[a] > uses[b];
+            });
+            pairs.resize(std::min(pairs.size(), memory_budget / sizeof(hype::Bits<D>)));
+            admit(pairs);
+        }
+
+        // Fills every admitted pair now, split across `threads` threads.
+        void fill(std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+            std::atomic<std::size_t> next(0);
+            std::vector<std::thread> workers;
+            for (std::size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&]() {
+                    for (std::size_t i = next++; i < admitted.size(); i = next++) {
+                        entry(admitted[i]);
+                    }
+                });
+            }
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        // Packs the item memories again if they changed since they were last packed, e.g. because the model was
+        // loaded after this table was built. The admitted pairs stay admitted but are filled anew. Hashing the memories
+        // takes a pass over them, so this is meant to run before a batch of samples, and not alongside encode().
+        // Returns whether they had changed.
+        bool refresh() {
+            std::uint64_t current = memories_hash();
+            if (current == packed) {
+                return false;
+            }
+            channels = pack(channel_memory);
+            levels = pack(level_memory);
+            packed = current;
+            admit(std::vector<std::size_t>(admitted));
+            return true;
+        }
+
+        // Safe to call from several threads at once.
+        Vect<D> encode(const hype::Vector<F, data_t> &data_point) const {
+            // Reused by every call on the same thread, so encoding allocates nothing once warm.
+            thread_local Scratch scratch;
+            scratch.pairs.clear();
+            scratch.computed.resize(channels.size());
+            std::size_t computed = 0;
+            channel_memory.for_each_channel([&](std::size_t c, const Vect<D> &) {
+                if (data_point[c] < MIN_FREQUENCY || data_point[c] > MAX_FREQUENCY) {
+                    throw hype::error("Frequency of ", data_point[c], " is outside expected range of [", MIN_FREQUENCY,
+                                      ", ", MAX_FREQUENCY, "]");
+                }
+                std::size_t pair = c * levels.size() + frequency_bin(data_point[c], levels.size());
+                if (slots[pair] != NOT_ADMITTED) {
+                    scratch.pairs.push_back(&entry(pair));
+                } else {
+                    hype::Bits<D> &bound = scratch.computed[computed++];
+                    bound = channels[c];
+                    bound ^= levels[pair % levels.size()];
+                    scratch.pairs.push_back(&bound);
+                }
+            });
+
+            scratch.negatives.clear();
+            scratch.negatives.add(scratch.pairs.size(),
+                                  [&](std::size_t i) -> const hype::Bits<D> & { return *scratch.pairs[i]; });
+            scratch.negatives.counts(scratch.counts.data());
+            Vect<D> result;
+            for (std::size_t d = 0; d < D; ++d) {
+                result[d] = static_cast<data_t>(scratch.pairs.size()) - 2 * static_cast<data_t>(scratch.counts[d]);
+            }
+            return result;
+        }
+
+        // Pairs admitted under the memory budget, and the bytes they take once filled.
+        [[nodiscard]]
+        std::size_t size() const {
+            return admitted.size();
+        }
+
+        [[nodiscard]]
+        std::size_t bytes() const {
+            return admitted.size() * sizeof(hype::Bits<D>);
+        }
+
+    private:
+        struct Scratch {
+            std::vector<const hype::Bits<D> *> pairs;
+            std::vector<hype::Bits<D>> computed;
+            hype::BitCounts<D> negatives;
+            std::array<std::uint32_t, D> counts;
+        };
+
+        std::uint64_t memories_hash() const {
+            return level_memory.hash(channel_memory.hash());
+        }
+
+        void admit(const std::vector<std::size_t> &pairs) {
+            if (pairs.size() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+                throw hype::error("Cannot admit ", pairs.size(), " bound pairs.");
+            }
+            slots.assign(channels.size() * levels.size(), NOT_ADMITTED);
+            for (std::size_t i = 0; i < pairs.size(); ++i) {
+                slots[pairs[i]] = static_cast<std::int32_t>(i);
+            }
+            admitted = pairs;
+            entries = std::make_unique<hype::Bits<D>[]>(pairs.size());
+            filled = std::make_unique<std::once_flag[]>(pairs.size());
+        }
+
+        const hype::Bits<D> &entry(std::size_t pair) const {
+            std::size_t slot = slots[pair];
+            std::call_once(filled[slot], [&]() {
+                entries[slot] = channels[pair / levels.size()] ^ levels[pair % levels.size()];
+            });
+            return entries[slot];
+        }
+
+        const hype::FrequencyChannelMemory<Vect<D>> &channel_memory;
+        const hype::ContinuousItemMemory<Vect<D>> &level_memory;
+        std::vector<hype::Bits<D>> channels;
+        std::vector<hype::Bits<D>> levels;
+        // Hash of the item memories as packed into `channels` and `levels`.
+        std::uint64_t packed;
+        // Slot of every pair in `entries`, or NOT_ADMITTED.
+        std::vector<std::int32_t> slots;
+        std::vector<std::size_t> admitted;
+        std::unique_ptr<hype::Bits<D>[]> entries;
+        std::unique_ptr<std::once_flag[]> filled;
+    };
+
+} // namespace hdvr
@@ -0,0 +1,263 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Metrics.h"
+#include "hype/Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECKPOINT_VERSION 2
+
+namespace hdvr {
+
+    // Everything train() needs to carry on after the end of an epoch.
+    template<typename Memory>
+    struct Checkpoint {
+        // What the run depends on, one "key: value" per line; a checkpoint only resumes a run with the same manifest.
+        std::string manifest;
+        int epoch = 0;
+        // Training stopped early, so there is nothing left to resume.
+        bool stopped = false;
+        float seconds = 0;
+        std::string random_state;
+        float best_accuracy = 0;
+        int best_epoch = 0;
+        int evaluations_since_best = 0;
+        Memory memory;
+        Memory best_memory;
+        Metrics metrics{""};
+    };
+
+    // Writes checkpoints to `directory` on a background thread, every `interval` epochs and/or every `seconds`
+    // seconds. The training thread only copies the state into a pending slot; if the writer is still busy with an
+    // older checkpoint when a newer one arrives, the older pending one is dropped. Each checkpoint replaces the
+    // previous one by an atomic rename, so a crash leaves either of the two behind, never a torn one. The writer only
+    // runs while a checkpoint is pending or being written.
+    template<typename Memory>
+    class Checkpointer {
+    private:
+        static std::string file(const std::string &directory) {
+            return directory + "/./checkpoint";
+        }
+
+        static void write_memory(std::ostream &os, const std::string &name, const Memory &memory) {
+            os << name << " " << memory.size() << "\n";
+            for (const auto &element: memory) {
+                os << element << "\n";
+            }
+        }
+
+        static Memory read_memory(std::istream &is, const std::string &name) {
+            std::string line;
+            std::getline(is, line);
+            std::stringstream ss(line);
+            std::string key;
+            std::size_t size = 0;
+            ss >> key >> size;
+            if (key != name) {
+                throw hype::error("Expected ", name, " but found '", line, "'.");
+            }
+
+            Memory memory;
+            for (std::size_t i = 0; i < size; ++i) {
+                if (!std::getline(is, line)) {
+                    throw hype::error("Expected ", size, " elements in ", name, " but found ", i, ".");
+                }
+                memory.insert(typename Memory::value_type(line));
+            }
+            return memory;
+        }
+
+        static std::string encode(const Checkpoint<Memory> &checkpoint) {
+            std::stringstream ss;
+            ss.precision(std::numeric_limits<float>::max_digits10);
+            ss << "checkpoint " << CHECKPOINT_VERSION << "\n"
+               << "manifest " << std::count(checkpoint.manifest.begin(), checkpoint.manifest.end(), '\n') << "\n"
+               << checkpoint.manifest
+               << "epoch " << checkpoint.epoch << "\n"
+               << "stopped " << checkpoint.stopped << "\n"
+               << "seconds " << checkpoint.seconds << "\n"
+               << "random " << checkpoint.random_state << "\n"
+               << "best " << checkpoint.best_accuracy << " " << checkpoint.best_epoch << " "
+               << checkpoint.evaluations_since_best << "\n";
+            write_memory(ss, "memory", checkpoint.memory);
+            write_memory(ss, "best_memory", checkpoint.best_memory);
+            checkpoint.metrics.serialize(ss);
+            return ss.str();
+        }
+
+        static Checkpoint<Memory> decode(const std::string &str) {
+            std::stringstream ss(str);
+            Checkpoint<Memory> checkpoint;
+            std::string key;
+            int version = 0;
+            ss >> key >> version;
+            if (key != "checkpoint" || version != CHECKPOINT_VERSION) {
+                throw hype::error("Unsupported checkpoint format.");
+            }
+            std::size_t lines = 0;
+            ss >> key >> lines;
+            ss.get();
+            for (std::size_t i = 0; i < lines; ++i) {
+                std::string line;
+                if (key != "manifest" || !std::getline(ss, line)) {
+                    throw hype::error("Malformed checkpoint manifest.");
+                }
+                checkpoint.manifest += line + "\n";
+            }
+            ss >> key >> checkpoint.epoch >> key >> checkpoint.stopped >> key >> checkpoint.seconds >> key;
+            ss.get();
+            std::getline(ss, checkpoint.random_state);
+            ss >> key >> checkpoint.best_accuracy >> checkpoint.best_epoch >> checkpoint.evaluations_since_best;
+            ss.get();
+            if (!ss) {
+                throw hype::error("Malformed checkpoint header.");
+            }
+            checkpoint.memory = read_memory(ss, "memory");
+            checkpoint.best_memory = read_memory(ss, "best_memory");
+            checkpoint.metrics = Metrics::deserialize(ss);
+            return checkpoint;
+        }
+
+        // Writes checkpoints until none is pending, then lets the writer exit, so that an idle checkpointer holds no
+        // thread.
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (pending.has_value()) {
+                Checkpoint<Memory> checkpoint = std::move(*pending);
+                pending.reset();
+                lock.unlock();
+
+                try {
+                    hype::save_file_atomically(file(directory), encode(checkpoint));
+                } catch (std::runtime_error &e) {
+                    hype::log_error_nl("Failed to write checkpoint: ", e.what());
+                }
+
+                lock.lock();
+            }
+            writing = false;
+        }
+
+    public:
+        Checkpointer(const std::string &directory_, int interval_, float seconds_)
+                : directory(directory_), interval(interval_), seconds(seconds_),
+                  last(std::chrono::steady_clock::now()) {
+            hype::make_directories(directory);
+        }
+
+        Checkpointer(const Checkpointer &) = delete;
+
+        Checkpointer &operator=(const Checkpointer &) = delete;
+
+        // Waits for the last checkpoint to be written.
+        ~Checkpointer() {
+            stop();
+        }
+
+        // Waits for the pending checkpoint, if any, to be written and for the writer to exit, e.g. so that no thread
+        // holds a lock while the process forks. Returns at once when no checkpoint is pending or being written.
+        void stop() {
+            if (writer.joinable()) {
+                writer.join();
+            }
+        }
+
+        [[nodiscard]]
+        bool due(int epoch) const {
+            if (interval > 0 && epoch % interval == 0) {
+                return true;
+            }
+            return seconds > 0 &&
+                   std::chrono::duration<float>(std::chrono::steady_clock::now() - last).count() >= seconds;
+        }
+
+        // Replaces any checkpoint still pending with `checkpoint`, and starts the writer unless it is still running.
+        void submit(Checkpoint<Memory> &&checkpoint) {
+            last = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mutex);
+            pending = std::move(checkpoint);
+            if (writing) {
+                return;
+            }
+            writing = true;
+            lock.unlock();
+            stop();
+            writer = std::thread([this]() { run(); });
+        }
+
+        // The latest complete checkpoint in `directory`, if any. Throws if it was taken by a run with another manifest
+        // than `manifest`, rather than carry on from another model, dataset or set of options.
+        static std::optional<Checkpoint<Memory>> load(const std::string &directory, const std::string &manifest) {
+            if (!hype::is_file(file(directory))) {
+                return std::nullopt;
+            }
+            std::optional<Checkpoint<Memory>> checkpoint;
+            try {
+                checkpoint = decode(hype::read_file_directly(file(directory)));
+            } catch (std::exception &e) {
+                hype::log_error_nl("Ignoring unreadable checkpoint in ", directory, ": ", e.what());
+                return std::nullopt;
+            }
+
+            if (checkpoint->manifest != manifest) {
+                auto lines = [](const std::string &text) {
+                    std::vector<std::string> result;
+                    std::stringstream ss(text);
+                    for (std::string line; std::getline(ss, line);) {
+                        result.emplace_back(line);
+                    }
+                    return result;
+                };
+                auto expected = lines(manifest);
+                auto found = lines(checkpoint->manifest);
+                std::size_t i = 0;
+                while (i < expected.size() && i < found.size() && expected[i] == found[i]) {
+                    ++i;
+                }
+                std::string expected_line = i < expected.size() ? expected[i] : "";
+                std::string found_line = i < found.size() ? found[i] : "";
+                throw hype::error("Refusing to resume from the checkpoint in ", directory, ", which was taken by another run: ",
+                                  "expected '", expected_line, "' but found '", found_line, "'.");
+            }
+            return checkpoint;
+        }
+
+    private:
+        std::string directory;
+        int interval;
+        float seconds;
+        std::chrono::steady_clock::time_point last;
+        std::mutex mutex;
+        std::optional<Checkpoint<Memory>> pending;
+        bool writing = false;
+        std::thread writer;
+    };
+} // namespace hdvr
@@ -0,0 +1,253 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "hype/BoundedQueue.h"
+#include "hype/Utils.h"
+
+namespace hdvr {
+
+#define CHUNKED_DATASET_MAGIC "HDVRCHNK"
+#define CHUNKED_DATASET_VERSION 1
+
+    // Encoded samples stored on disk as fixed size records behind a small header, so that any range of them can be
+    // read without reading what comes before it. Like the binary dataset files, meant as a cache on one machine.
+    template<typename X, typename Y>
+    struct ChunkedRecord {
+        static_assert(std::is_trivially_copyable_v<X> && std::is_trivially_copyable_v<Y>,
+                      "Chunked datasets hold trivially copyable samples and labels only.");
+        X data;
+        Y label;
+    };
+
+    struct ChunkedHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint64_t count;
+    };
+
+    // Appends samples to a chunked dataset file. The file is written next to its destination and only moved into
+    // place by close(), so an interrupted write never leaves a truncated dataset behind.
+    template<typename X, typename Y>
+    class ChunkedDatasetWriter {
+    public:
+        explicit ChunkedDatasetWriter(const std::string &path_) : path(path_), file(path_ + ".tmp", std::ios::binary) {
+            if (!file.is_open()) {
+                throw hype::error("Could not open file at path: ", path + ".tmp");
+            }
+            write_header();
+        }
+
+        ChunkedDatasetWriter(const ChunkedDatasetWriter &) = delete;
+
+        ChunkedDatasetWriter &operator=(const ChunkedDatasetWriter &) = delete;
+
+        void add(const X &data, const Y &label) {
+            ChunkedRecord<X, Y> record{data, label};
+            if (!file.write(reinterpret_cast<const char *>(&record), sizeof(record))) {
+                throw hype::error("Could not write file at path: ", path + ".tmp");
+            }
+            ++count;
+        }
+
+        void close() {
+            file.seekp(0);
+            write_header();
+            file.close();
+            if (!file) {
+                throw hype::error("Could not write file at path: ", path + ".tmp");
+            }
+            std::filesystem::rename(path + ".tmp", path);
+        }
+
+        [[nodiscard]]
+        std::size_t size() const {
+            return count;
+        }
+
+    private:
+        void write_header() {
+            ChunkedHeader header{};
+            std::memcpy(header.magic, CHUNKED_DATASET_MAGIC, sizeof(header.magic));
+            header.version = CHUNKED_DATASET_VERSION;
+            header.record_size = sizeof(ChunkedRecord<X, Y>);
+            header.count = count;
+            if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header))) {
+                throw hype::error("Could not write file at path: ", path + ".tmp");
+            }
+        }
+
+        std::string path;
+        std::ofstream file;
+        std::uint64_t count = 0;
+    };
+
+    // Streams a chunked dataset file chunk by chunk. A prefetch thread reads ahead into a fixed set of buffers while
+    // the caller works on the current chunk, so I/O overlaps with compute and at most `memory_budget` bytes of samples
+    // are ever held in memory, however large the file.
+    template<typename X, typename Y>
+    class ChunkedDataset {
+    public:
+        using Record = ChunkedRecord<X, Y>;
+
+        // The budget is split evenly across `buffers` chunks: one being worked on, the rest being read ahead.
+        ChunkedDataset(const std::string &path_, std::size_t memory_budget, std::size_t buffers_ = 4)
+                : path(path_), buffers(std::max<std::size_t>(2, buffers_)) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                throw hype::error("Could not open file at path: ", path);
+            }
+            ChunkedHeader header{};
+            if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+                std::memcmp(header.magic, CHUNKED_DATASET_MAGIC, sizeof(header.magic)) != 0) {
+                throw hype::error("File at path ", path, " is not a chunked dataset.");
+            }
+            if (header.version != CHUNKED_DATASET_VERSION || header.record_size != sizeof(Record)) {
+                throw hype::error("Chunked dataset at path ", path, " was written in an incompatible format.");
+            }
+            count = header.count;
+            if (count == 0) {
+                throw hype::error("Loaded dataset at ", path, " but it is empty.");
+            }
+
+            chunk = std::max<std::size_t>(1, memory_budget / buffers / sizeof(Record));
+            if (chunk == 1 && memory_budget < buffers * sizeof(Record)) {
+                hype::log_error_nl("Memory budget of ", memory_budget, " bytes is below ", buffers, " samples of ",
+                                   sizeof(Record), " bytes; streaming one sample per chunk.");
+            }
+        }
+
+        [[nodiscard]]
+        std::size_t size() const {
+            return count;
+        }
+
+        [[nodiscard]]
+        std::size_t chunks() const {
+            return (count + chunk - 1) / chunk;
+        }
+
+        [[nodiscard]]
+        std::size_t chunk_size() const {
+            return chunk;
+        }
+
+        // Index of the first sample in chunk `c`.
+        [[nodiscard]]
+        std::size_t offset(std::size_t c) const {
+            return c * chunk;
+        }
+
+        // Calls `callback(c, records)` for every chunk c in `order`, in that order. `records` is only valid during
+        // the call. Exceptions from either the reader or `callback` stop the pass and are rethrown here.
+        template<typename F>
+        void for_each_chunk(const std::vector<std::size_t> &order, F &&callback) const {
+            struct Loaded {
+                std::size_t index = 0;
+                std::vector<Record> records;
+            };
+            hype::BoundedQueue<Loaded> free(buffers);
+            hype::BoundedQueue<Loaded> loaded(buffers);
+            for (std::size_t i = 0; i < buffers; ++i) {
+                Loaded buffer;
+                buffer.records.reserve(chunk);
+                free.try_push(std::move(buffer));
+            }
+
+            std::exception_ptr failure = nullptr;
+            std::thread reader([&]() {
+                try {
+                    std::ifstream file(path, std::ios::binary);
+                    if (!file.is_open()) {
+                        throw hype::error("Could not open file at path: ", path);
+                    }
+                    Loaded buffer;
+                    for (const auto &c: order) {
+                        if (c >= chunks()) {
+                            throw hype::error("Chunk ", c, " is out of range for dataset of ", chunks(), " chunks.");
+                        }
+                        if (!free.pop(buffer)) {
+                            break;
+                        }
+                        buffer.index = c;
+                        buffer.records.resize(std::min(chunk, count - offset(c)));
+                        file.seekg(static_cast<std::streamoff>(sizeof(ChunkedHeader) + offset(c) * sizeof(Record)));
+                        if (!file.read(reinterpret_cast<char *>(buffer.records.data()),
+                                       static_cast<std::streamsize>(buffer.records.size() * sizeof(Record)))) {
+                            throw hype::error("Could not read chunk ", c, " of dataset at path: ", path);
+                        }
+                        if (!loaded.push(std::move(buffer))) {
+                            break;
+                        }
+                    }
+                } catch (...) {
+                    failure = std::current_exception();
+                }
+                loaded.close();
+            });
+
+            try {
+                Loaded buffer;
+                while (loaded.pop(buffer)) {
+                    callback(buffer.index, static_cast<const std::vector<Record> &>(buffer.records));
+                    free.try_push(std::move(buffer));
+                }
+            } catch (...) {
+                free.close();
+                loaded.close();
+                reader.join();
+                throw;
+            }
+            reader.join();
+            if (failure != nullptr) {
+                std::rethrow_exception(failure);
+            }
+        }
+
+        // Visits every chunk in file order.
+        template<typename F>
+        void for_each_chunk(F &&callback) const {
+            std::vector<std::size_t> order(chunks());
+            std::iota(order.begin(), order.end(), 0);
+            for_each_chunk(order, std::forward<F>(callback));
+        }
+
+    private:
+        std::string path;
+        std::size_t buffers;
+        std::size_t count = 0;
+        std::size_t chunk = 1;
+    };
+
+} // namespace hdvr
@@ -23,12 +23,17 @@
 #include <string>
 #include <utility>
 #include <set>
+#include <memory>
+#include <vector>
 
 #include "hype/Utils.h"
 #include "Types.h"
 
 namespace hdvr {
 
+    template<typename X, typename Y>
+    class DatasetView;
+
     template<typename X, typename Y>
     class Dataset {
     private:
@@ -38,7 +43,7 @@ namespace hdvr {
         public:
             Iterator(F it1_, S it2_) : it1(it1_), it2(it2_) {}
 
-            std::pair<X, Y> operator*() const {
+            std::pair<decltype(*std::declval<F>()), decltype(*std::declval<S>())> operator*() const {
                 return {*it1, *it2};
             }
 
@@ -93,6 +98,22 @@ namespace hdvr {
             hype::save_file<Y>(labels_path, labels);
         }
 
+        void load_binary(const std::string &data_path, const std::string &labels_path) {
+            data = hype::read_binary_file<X>(data_path);
+            labels = hype::read_binary_file<Y>(labels_path);
+
+            if (data.size() != labels.size()) {
+                throw hype::error("Mismatching amount of data (", data.size(), ") and labels (", labels.size(), ").");
+            } else if (data.empty()) {
+                throw hype::error("Loaded dataset at ", data_path, " but it is empty.");
+            }
+        }
+
+        void save_binary(const std::string &data_path, const std::string &labels_path) {
+            hype::save_binary_file<X>(data_path, data);
+            hype::save_binary_file<Y>(labels_path, labels);
+        }
+
         iterator begin() {
             return {data.begin(), labels.begin()};
         }
@@ -109,15 +130,32 @@ namespace hdvr {
             return {data.end(), labels.end()};
         }
 
-        void add(const std::pair<X, Y> &&to_add) {
-            data.emplace_back(to_add.first);
-            labels.emplace_back(to_add.second);
+        void add(std::pair<X, Y> &&to_add) {
+            data.emplace_back(std::move(to_add.first));
+            labels.emplace_back(std::move(to_add.second));
         }
 
-        const std::pair<X, Y> operator[](std::size_t i) const {
+        void reserve(std::size_t size) {
+            data.reserve(size);
+            labels.reserve(size);
+        }
+
+        std::pair<const X &, const Y &> operator[](std::size_t i) const {
             return {data[i], labels[i]};
         }
 
+        DatasetView<X, Y> view() const {
+            return DatasetView<X, Y>(*this);
+        }
+
+        DatasetView<X, Y> slice(std::size_t begin, std::size_t end) const {
+            return view().slice(begin, end);
+        }
+
+        DatasetView<X, Y> permute(const std::vector<std::size_t> &order) const {
+            return view().permute(order);
+        }
+
         std::size_t size() const {
             return data.size();
         }
@@ -127,8 +165,99 @@ namespace hdvr {
         }
 
     private:
+        friend class DatasetView<X, Y>;
+
         std::vector<X> data;
         std::vector<Y> labels;
     };
 
+    // Non-owning view of a Dataset, optionally restricted to a slice or reordered by an index permutation. Elements
+    // are handed out as references into the underlying dataset, which must therefore outlive the view.
+    template<typename X, typename Y>
+    class DatasetView {
+    private:
+        class Iterator {
+        public:
+            Iterator(const DatasetView *view_, std::size_t position_) : view(view_), position(position_) {}
+
+            std::pair<const X &, const Y &> operator*() const {
+                return (*view)[position];
+            }
+
+            Iterator &operator++() {
+                ++position;
+                return *this;
+            }
+
+            bool operator!=(const Iterator &other) const {
+                return position != other.position || view != other.view;
+            }
+
+        private:
+            const DatasetView *view;
+            std::size_t position;
+        };
+
+        std::size_t index(std::size_t i) const {
+            return indices == nullptr ? offset + i : (*indices)[offset + i];
+        }
+
+    public:
+        DatasetView(const Dataset<X, Y> &dataset) : data(&dataset.data), labels(&dataset.labels), offset(0),
+                                                   count(dataset.size()) {}
+
+        std::pair<const X &, const Y &> operator[](std::size_t i) const {
+            std::size_t j = index(i);
+            return {(*data)[j], (*labels)[j]};
+        }
+
+        [[nodiscard]]
+        std::size_t size() const {
+            return count;
+        }
+
+        Iterator begin() const {
+            return {this, 0};
+        }
+
+        Iterator end() const {
+            return {this, count};
+        }
+
+        DatasetView slice(std::size_t begin, std::size_t end) const {
+            if (begin > end || end > count) {
+                throw hype::error("Invalid slice [", begin, ", ", end, ") of dataset view of size ", count, ".");
+            }
+            DatasetView result(*this);
+            result.offset = offset + begin;
+            result.count = end - begin;
+            return result;
+        }
+
+        // Element i of the result is element order[i] of this view. Only the indices are copied.
+        DatasetView permute(const std::vector<std::size_t> &order) const {
+            auto permuted = std::make_shared<std::vector<std::size_t>>();
+            permuted->reserve(order.size());
+            for (const auto &i: order) {
+                if (i >= count) {
+                    throw hype::error("Permutation index ", i, " is out of range for dataset view of size ", count, ".");
+                }
+                permuted->emplace_back(index(i));
+            }
+
+            DatasetView result(*this);
+            result.indices = std::move(permuted);
+            result.offset = 0;
+            result.count = result.indices->size();
+            return result;
+        }
+
+    private:
+        const std::vector<X> *data;
+        const std::vector<Y> *labels;
+        std::shared_ptr<const std::vector<std::size_t>> indices;
+        std::size_t offset;
+        std::size_t count;
+    };
+
 } // namespace hdvr
\ No newline at end of file
@@ -0,0 +1,144 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Model.h"
+#include "StaticEngine.h"
+#include "hype/Utils.h"
+
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace hdvr {
+
+    // A model in the form StaticEngine takes it: bit-packed item memories, and the prototypes with their norms.
+    template<std::size_t L, std::size_t D, std::size_t F>
+    struct PackedModel {
+        std::vector<std::uint64_t> levels;
+        std::vector<std::uint64_t> channels;
+        std::vector<float> prototypes;
+        std::vector<float> norms;
+
+        [[nodiscard]]
+        std::size_t classes() const {
+            return norms.size();
+        }
+
+        // An engine over this packed model, which must outlive it.
+        StaticEngine<L, D, F> engine() const {
+            return StaticEngine<L, D, F>(levels.data(), channels.data(), prototypes.data(), norms.data(), classes());
+        }
+    };
+
+    template<std::size_t D, typename T>
+    void pack_bipolar(const hype::Memory<T> &memory, std::vector<std::uint64_t> &words) {
+        constexpr std::size_t WORDS = StaticEngine<1, D, 1>::WORDS;
+        for (const auto &vector: memory) {
+            std::size_t offset = words.size();
+            words.resize(offset + WORDS, 0);
+            for (std::size_t d = 0; d < D; ++d) {
+                if (vector[d] == -1) {
+                    words[offset + d / 64] |= std::uint64_t{1} << (d % 64);
+                } else if (vector[d] != 1) {
+                    throw hype::error("Cannot export item memory with component ", vector[d], "; it must be bipolar.");
+                }
+            }
+        }
+    }
+
+    template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
+    PackedModel<L, D, F> pack(const Model<L, D, F, S> &model) {
+        if constexpr (!std::is_same_v<Vect<D>, hype::Vector<D, float>>) {
+            throw hype::error("Only models of real-valued hypervectors can be exported.");
+        } else {
+            if (model.continuousItemMemory.size() != L || model.frequencyChannelMemory.size() != F) {
+                throw hype::error("Cannot export model with ", model.continuousItemMemory.size(), " levels and ",
+                                  model.frequencyChannelMemory.size(), " channels; expected ", L, " and ", F, ".");
+            }
+            if (model.frequencyChannelMemory.masked()) {
+                throw hype::error("Cannot export model with a channel mask; the static engine encodes every channel.");
+            }
+            if (model.associativeMemory.size() == 0) {
+                throw hype::error("Cannot export model without prototypes.");
+            }
+
+            PackedModel<L, D, F> result;
+            pack_bipolar<D>(model.continuousItemMemory, result.levels);
+            pack_bipolar<D>(model.frequencyChannelMemory, result.channels);
+            for (const auto &prototype: model.associativeMemory) {
+                double magnitude = 0.0;
+                for (std::size_t d = 0; d < D; ++d) {
+                    result.prototypes.push_back(prototype[d]);
+                    magnitude += static_cast<double>(prototype[d]) * prototype[d];
+                }
+                result.norms.push_back(static_cast<float>(std::sqrt(magnitude)));
+            }
+            return result;
+        }
+    }
+
+    // Writes `model` to `path` as a C++ header defining its packed memories as constexpr arrays in namespace
+    // `name`, along with an engine() over them. Floats are written in hexadecimal, so they are reproduced exactly.
+    template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
+    void export_model(const Model<L, D, F, S> &model, const std::string &path, const std::string &name) {
+        auto packed = pack(model);
+
+        std::stringstream ss;
+        auto array = [&](const char *type, const char *array_name, const auto &values, std::size_t per_line) {
+            ss << "    inline constexpr " << type << " " << array_name << "[" << values.size() << "] = {";
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                ss << (i % per_line == 0 ? "\n        " : " ");
+                if constexpr (std::is_same_v<std::decay_t<decltype(values[i])>, float>) {
+                    ss << std::hexfloat << values[i] << std::defaultfloat << "f,";
+                } else {
+                    ss << "0x" << std::hex << values[i] << std::dec << "ULL,";
+                }
+            }
+            ss << "\n    };\n\n";
+        };
+
+        ss << "// Generated by HDVR from a trained model. Do not edit.\n\n"
+           << "#pragma once\n\n"
+           << "#include \"StaticEngine.h\"\n\n"
+           << "namespace " << name << " {\n"
+           << "    inline constexpr std::size_t levels = " << L << ";\n"
+           << "    inline constexpr std::size_t dimensions = " << D << ";\n"
+           << "    inline constexpr std::size_t frequency_points = " << F << ";\n"
+           << "    inline constexpr std::size_t classes = " << packed.classes() << ";\n\n";
+        array("std::uint64_t", "continuous_item_memory", packed.levels, 8);
+        array("std::uint64_t", "frequency_channel_memory", packed.channels, 8);
+        array("float", "associative_memory", packed.prototypes, 8);
+        array("float", "norms", packed.norms, 8);
+        ss << "    using Engine = hdvr::StaticEngine<levels, dimensions, frequency_points>;\n\n"
+           << "    inline Engine engine() noexcept {\n"
+           << "        return Engine(continuous_item_memory, frequency_channel_memory, associative_memory, norms, "
+           << "classes);\n"
+           << "    }\n"
+           << "} // namespace " << name << "\n";
+
+        hype::save_file_directly(path, ss.str());
+    }
+
+} // namespace hdvr
@@ -0,0 +1,45 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+namespace hdvr {
+
+#define MAX_FREQUENCY 1.0
+#define MIN_FREQUENCY -1.0
+
+    // Quantises a frequency in [MIN_FREQUENCY, MAX_FREQUENCY] into one of `bin_levels` equally wide bins. Frequencies
+    // outside the range land in the nearest bin; callers that consider them an error must check for themselves.
+    template<typename T>
+    constexpr int frequency_bin(T frequency, int bin_levels) noexcept {
+        T range = static_cast<T>(MAX_FREQUENCY) - static_cast<T>(MIN_FREQUENCY);
+        T step = range / bin_levels;
+
+        for (int i = 0; i < bin_levels; ++i) {
+            T threshold = static_cast<T>(MIN_FREQUENCY) + (step * (i + 1));
+            if (frequency <= threshold) {
+                return i;
+            }
+        }
+
+        return bin_levels - 1;
+    }
+
+} // namespace hdvr
@@ -20,125 +20,565 @@
 #pragma once
 
 #include "Model.h"
+#include "BoundPairs.h"
+#include "Checkpoint.h"
+#include "ChunkedDataset.h"
 #include "Dataset.h"
+#include "Frequency.h"
 #include "Types.h"
 #include "Metrics.h"
+#include "TrainingOptions.h"
+#include "Shards.h"
+#include "hype/BoundedQueue.h"
+#include "hype/Histogram.h"
+#include "hype/Index.h"
+#include "hype/Projection.h"
 
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 
 namespace hdvr {
 
-#define MAX_FREQUENCY ((data_t)1.0)
-#define MIN_FREQUENCY ((data_t)-1.0)
 #define PROGRESS_UPDATES 10
+#define PIPELINE_QUEUE_CAPACITY 64
+// Samples encoded together by the random projection, which turns a batch into a single matrix product.
+#define ENCODE_BATCH 64
+// Fraction of channels beyond which encode_delta() encodes a frame in full, rebinding a channel costing about twice
+// as much as binding it.
+#define DELTA_THRESHOLD 0.4
+// Bump whenever encode() or the format of cached encodings changes, so that caches from older versions are not reused.
+#define ENCODER_VERSION 2
 
 
     template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
     class HDVR {
     private:
-        int frequency_bin(const data_t &frequency, int bin_levels) {
-            if (frequency < MIN_FREQUENCY || frequency > MAX_FREQUENCY) {
-                throw hype::error("Frequency of ", frequency, " is outside expected range of [", MIN_FREQUENCY, ", ",
-                                  MAX_FREQUENCY, "]");
+        // Encoded samples are kept as 16-bit integers whenever every component provably fits, which halves the memory
+        // the training and testing loops stream through. Otherwise they are kept as they are encoded.
+        static constexpr bool compact = std::is_same_v<Vect<D>, hype::Vector<D, data_t>> &&
+                                        (S == hype::POLAR || S == hype::BINARY) &&
+                                        F <= static_cast<std::size_t>(std::numeric_limits<encoded_t>::max());
+        using Encoded = std::conditional_t<compact, EncodedVect<D>, Vect<D>>;
+        using Memory = hype::AssociativeMemory<Vect<D>>;
+
+        // Encodes several samples at once. The random projection encodes them as one matrix product; the other
+        // encoders encode them one by one. Callers spread batches across threads themselves.
+        std::vector<Vect<D>> encode(const std::vector<const hype::Vector<F, data_t> *> &inputs) const {
+            std::vector<Vect<D>> result;
+            result.reserve(inputs.size());
+            if (encoder != RANDOM_PROJECTION) {
+                for (const auto *input: inputs) {
+                    result.emplace_back(encode(*input));
+                }
+                return result;
             }
 
-            data_t range = MAX_FREQUENCY - MIN_FREQUENCY;
-            data_t step = range / bin_levels;
+            // Channels masked out of the frequency channel memory are left at zero, which drops them from the product.
+            std::vector<float> batch(inputs.size() * F, 0.0f);
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                model.frequencyChannelMemory.for_each_channel([&](std::size_t f, const Vect<D> &) {
+                    batch[i * F + f] = (*inputs[i])[f];
+                });
+            }
+            std::vector<float> projected(inputs.size() * D);
+            projection->project(batch.data(), inputs.size(), projected.data());
 
-            for (int i = 0; i < bin_levels; ++i) {
-                data_t threshold = MIN_FREQUENCY + (step * (i + 1));
-                if (frequency <= threshold) {
-                    return i;
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                Vect<D> vector;
+                if constexpr (std::is_same_v<Vect<D>, hype::Vector<D, data_t>>) {
+                    for (std::size_t d = 0; d < D; ++d) {
+                        vector[d] = projected[i * D + d] < 0 ? -1 : 1;
+                    }
+                } else if constexpr (std::is_same_v<Vect<D>, hype::BinaryVector<D>>) {
+                    for (std::size_t d = 0; d < D; ++d) {
+                        vector[d] = projected[i * D + d] >= 0;
+                    }
+                } else {
+                    vector = Vect<D>::strongest(projected.data() + i * D);
                 }
+                result.emplace_back(std::move(vector));
             }
+            return result;
+        }
+
+        struct RawSample {
+            std::size_t index;
+            hype::Vector<F, data_t> data;
+        };
 
-            return bin_levels - 1;
+        struct EncodedSample {
+            std::size_t index;
+            Encoded data;
+        };
+
+        Dataset<Encoded, int> encode(const std::string &data_path, const std::string &labels_path, bool bundle,
+                                     float dataset_fraction = 1.0) {
+            auto labels = hype::read_file<int>(labels_path);
+            Dataset<Encoded, int> result;
+            result.reserve(labels.size());
+            encode(data_path, labels_path, labels, bundle, dataset_fraction, [&](Encoded &&sample, int label) {
+                result.add({std::move(sample), label});
+            });
+            return result;
         }
 
-        Vect<D> encode(const hype::Vector<F, data_t> &data_point) {
-            std::vector<Vect<D>> temp;
-            temp.reserve(data_point.size());
+        // Parses and encodes a raw dataset in a single streaming pass: a parser thread feeds a pool of encoder
+        // threads, which feed the calling thread through bounded queues. Encoded samples are handed to `sink` in file
+        // order, so only a queue's worth of samples is ever held here. With `bundle` set, samples are also bundled
+        // into the class prototypes of the associative memory as they arrive, which is equivalent to
+        // configure_memory().
+        template<typename Sink>
+        void encode(const std::string &data_path, const std::string &labels_path, const std::vector<int> &labels,
+                    bool bundle, float dataset_fraction, Sink &&sink) {
+            if (labels.empty()) {
+                throw hype::error("Loaded dataset at ", data_path, " but it is empty.");
+            }
+            refresh_bound_pairs();
 
-            int bin;
-            for (std::size_t i = 0; i < data_point.size(); ++i) {
-                bin = frequency_bin(data_point[i], model.continuousItemMemory.size());
-                auto bin_vec = model.frequencyChannelMemory[i];
-                auto item_vec = model.continuousItemMemory[bin];
-                auto result = mul(bin_vec, item_vec);
-                temp.emplace_back(std::move(result));
+            std::vector<std::size_t> class_limits;
+            if (bundle) {
+                for (const auto &label: labels) {
+                    if (label < 0) {
+                        throw hype::error("Encountered negative label (", label, ") in ", labels_path);
+                    }
+                    if (static_cast<std::size_t>(label) >= class_limits.size()) {
+                        class_limits.resize(label + 1, 0);
+                    }
+                    ++class_limits[label];
+                }
+                for (auto &limit: class_limits) {
+                    limit = static_cast<std::size_t>(limit * dataset_fraction);
+                }
             }
 
-            return add(std::move(temp));
-        }
+            // Encoders take whole batches off the raw queue, so it has room for a batch per encoder.
+            std::size_t encoders = std::max(1u, std::thread::hardware_concurrency());
+            std::size_t batch_size = encoder == RANDOM_PROJECTION ? ENCODE_BATCH : 1;
+            hype::BoundedQueue<RawSample> raw_queue(PIPELINE_QUEUE_CAPACITY + encoders * batch_size);
+            hype::BoundedQueue<EncodedSample> encoded_queue(PIPELINE_QUEUE_CAPACITY);
+
+            // Samples are only read once they are within `window` of the next one to be sunk, so however out of order
+            // the encoders finish, no more than `window` samples are in flight or parked at once.
+            std::size_t window = PIPELINE_QUEUE_CAPACITY * 2 + encoders * batch_size;
+            std::atomic<std::size_t> next(0);
 
-        Dataset<Vect<D>, int> encode(const Dataset<hype::Vector<F, data_t>, int> &dataset) {
-            Dataset<Vect<D>, int> result;
-            int chunk_size = dataset.size() / PROGRESS_UPDATES;
+            std::mutex failure_mutex;
+            std::mutex latency_mutex;
+            std::exception_ptr failure = nullptr;
+            auto fail = [&]() {
+                std::lock_guard<std::mutex> lock(failure_mutex);
+                if (failure == nullptr) {
+                    failure = std::current_exception();
+                }
+                raw_queue.close();
+                encoded_queue.close();
+            };
 
-            int i = 0;
-            for (const auto &data_point: dataset) {
-                ++i;
-                if (i % chunk_size == 0) {
-                    hype::log_info(" ", static_cast<int>(static_cast<float>(i) / dataset.size() * 100), "% ");
+            std::vector<std::thread> threads;
+            threads.emplace_back([&]() {
+                try {
+                    std::size_t index = 0;
+                    hype::for_each_line(data_path, [&](const std::string &line) {
+                        if (index >= labels.size()) {
+                            throw hype::error("Mismatching amount of data and labels (", labels.size(), ") in ",
+                                              data_path);
+                        }
+                        while (index >= next.load(std::memory_order_acquire) + window && !raw_queue.closed()) {
+                            std::this_thread::yield();
+                        }
+                        return raw_queue.push(RawSample{index++, hype::Vector<F, data_t>(line)});
+                    });
+                    if (index != labels.size() && !raw_queue.closed()) {
+                        throw hype::error("Mismatching amount of data (", index, ") and labels (", labels.size(), ").");
+                    }
+                    raw_queue.close();
+                } catch (...) {
+                    fail();
                 }
-                result.add({encode(data_point.first), data_point.second});
+            });
+
+            std::atomic<std::size_t> running_encoders(encoders);
+            for (std::size_t i = 0; i < encoders; ++i) {
+                threads.emplace_back([&]() {
+                    hype::LatencyHistogram latency;
+                    try {
+                        std::vector<RawSample> batch;
+                        std::vector<const hype::Vector<F, data_t> *> inputs;
+                        RawSample sample;
+                        bool open = true;
+                        while (open && raw_queue.pop(sample)) {
+                            batch.clear();
+                            batch.emplace_back(std::move(sample));
+                            while (batch.size() < batch_size && raw_queue.try_pop(sample)) {
+                                batch.emplace_back(std::move(sample));
+                            }
+                            inputs.clear();
+                            for (const auto &raw: batch) {
+                                inputs.push_back(&raw.data);
+                            }
+
+                            // Samples of a batch are encoded together, so each is recorded with the batch's average.
+                            auto start = std::chrono::steady_clock::now();
+                            auto encoded = encode(inputs);
+                            if (recording_latency) {
+                                auto each = (std::chrono::steady_clock::now() - start) / batch.size();
+                                for (std::size_t j = 0; j < batch.size(); ++j) {
+                                    latency.record(each);
+                                }
+                            }
+
+                            for (std::size_t j = 0; j < batch.size() && open; ++j) {
+                                open = encoded_queue.push(EncodedSample{batch[j].index, Encoded(std::move(encoded[j]))});
+                            }
+                        }
+                    } catch (...) {
+                        fail();
+                    }
+                    if (recording_latency) {
+                        std::lock_guard<std::mutex> lock(latency_mutex);
+                        encode_histogram.merge(latency);
+                    }
+                    if (running_encoders.fetch_sub(1) == 1) {
+                        encoded_queue.close();
+                    }
+                });
             }
-            return result;
-        }
 
-        std::vector<std::vector<Vect<D>>> get_class_vectors(const Dataset<Vect<D>, int> &dataset) {
-            std::vector<std::vector<Vect<D>>> class_vectors(dataset.class_set().size());
-            for (const auto &data_point: dataset) {
-                class_vectors.at(data_point.second).emplace_back(data_point.first);
+            // Encoders finish out of order, so samples are parked here until their predecessors have arrived.
+            std::vector<typename Vect<D>::Accumulator> accumulators(class_limits.size());
+            std::map<std::size_t, Encoded> pending;
+            std::size_t sunk = 0;
+            std::size_t chunk_size = std::max<std::size_t>(1, labels.size() / PROGRESS_UPDATES);
+
+            // A throwing sink stops the other threads as a failing one would, since they may be waiting on it.
+            try {
+                EncodedSample sample;
+                while (encoded_queue.pop(sample)) {
+                    pending.emplace(sample.index, std::move(sample.data));
+                    while (!pending.empty() && pending.begin()->first == sunk) {
+                        int label = labels[sunk];
+                        if (bundle && accumulators[label].size() < class_limits[label]) {
+                            accumulators[label].add(pending.begin()->second);
+                        }
+                        sink(std::move(pending.begin()->second), label);
+                        pending.erase(pending.begin());
+
+                        next.store(++sunk, std::memory_order_release);
+                        if (sunk % chunk_size == 0) {
+                            auto percent = static_cast<int>(static_cast<float>(sunk) / labels.size() * 100);
+                            hype::log_info(" ", percent, "% ");
+                        }
+                    }
+                }
+            } catch (...) {
+                fail();
+            }
+
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            if (failure != nullptr) {
+                std::rethrow_exception(failure);
+            }
+
+            if (bundle) {
+                model.associativeMemory.clear();
+                for (const auto &accumulator: accumulators) {
+                    model.associativeMemory.insert(accumulator.result());
+                }
             }
-            return class_vectors;
         }
 
-        void configure_memory(const Dataset<Vect<D>, int> &dataset, float dataset_fraction = 1.0) {
-            model.associativeMemory.clear();
-            auto class_vectors = get_class_vectors(dataset);
-            for (const auto &vectors: class_vectors) {
-                model.associativeMemory.insert(add(std::vector<Vect<D>>(vectors.begin(), vectors.begin() + (vectors.size() * dataset_fraction))));
+        // The model's item memories may have been loaded or changed since the bound-pair table packed them.
+        void refresh_bound_pairs() {
+            if constexpr (std::is_same_v<Vect<D>, hype::Vector<D, data_t>>) {
+                if (table) {
+                    table->refresh();
+                }
             }
         }
 
-        float train_one_epoch(const Dataset<Vect<D>, int> &dataset) {
-            int wrongs = 0;
-            int chunk_size = dataset.size() / PROGRESS_UPDATES;
+        void configure_memory(const DatasetView<Encoded, int> &dataset, float dataset_fraction_) {
+            dataset_fraction = dataset_fraction_;
+            model.associativeMemory.build_from(dataset, dataset_fraction);
+        }
+
+        // Prototypes and their updates are sums, so they can be computed per shard and added up afterwards.
+        static constexpr bool shardable = std::is_same_v<Vect<D>, hype::Vector<D, data_t>>;
+
+        void configure_memory(Memory &memory, const DatasetView<Encoded, int> &dataset, float fraction,
+                              const TrainingOptions &options) {
+            if (options.shards <= 0) {
+                memory.build_from(dataset, fraction);
+                return;
+            }
+
+            std::vector<std::size_t> limits;
+            for (const auto &[input, label]: dataset) {
+                if (static_cast<std::size_t>(label) >= limits.size()) {
+                    limits.resize(label + 1, 0);
+                }
+                ++limits[label];
+            }
+            for (auto &limit: limits) {
+                limit = static_cast<std::size_t>(limit * fraction);
+            }
 
+            // Which samples to bundle depends on their rank within their class, so it is decided up front.
+            std::vector<bool> included(dataset.size());
+            std::vector<std::size_t> seen(limits.size(), 0);
             for (std::size_t i = 0; i < dataset.size(); ++i) {
-                int prediction = predict(dataset[i].first);
-                if (prediction != dataset[i].second) {
-                    ++wrongs;
-                    model.associativeMemory[prediction] = sub(model.associativeMemory[prediction], dataset[i].first);
-                    model.associativeMemory[dataset[i].second] = add(model.associativeMemory[dataset[i].second],
-                                                                     dataset[i].first);
+                int label = dataset[i].second;
+                included[i] = seen[label]++ < limits[label];
+            }
+
+            std::size_t classes = limits.size();
+            Shards shards(options.shards, classes * D, options.shard_processes);
+            shards.run([&](std::size_t shard, float *slot) {
+                auto [begin, end] = shards.range(shard, dataset.size());
+                for (std::size_t i = begin; i < end; ++i) {
+                    if (!included[i]) {
+                        continue;
+                    }
+                    const auto &[input, label] = dataset[i];
+                    float *sum = slot + label * D;
+                    for (std::size_t d = 0; d < D; ++d) {
+                        sum[d] += input[d];
+                    }
+                }
+            });
+
+            if constexpr (shardable) {
+                memory.clear();
+                for (std::size_t c = 0; c < classes; ++c) {
+                    Vect<D> prototype;
+                    for (std::size_t d = 0; d < D; ++d) {
+                        data_t sum = 0;
+                        for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+                            sum += shards.slot(shard)[c * D + d];
+                        }
+                        prototype[d] = sum;
+                    }
+                    memory.insert(std::move(prototype));
+                }
+            }
+        }
+
+        // Bundles the first `fraction` of each class of a streamed dataset, as build_from() does in memory. Counting
+        // the classes takes a pass of its own, which is skipped when every sample is bundled anyway.
+        void configure_memory(Memory &memory, const ChunkedDataset<Encoded, int> &dataset, float fraction) {
+            std::vector<std::size_t> limits;
+            if (fraction < 1.0) {
+                dataset.for_each_chunk([&](std::size_t, const auto &records) {
+                    for (const auto &record: records) {
+                        if (record.label >= 0 && static_cast<std::size_t>(record.label) >= limits.size()) {
+                            limits.resize(record.label + 1, 0);
+                        }
+                        ++limits[record.label];
+                    }
+                });
+                for (auto &limit: limits) {
+                    limit = static_cast<std::size_t>(limit * fraction);
+                }
+            }
+
+            std::vector<typename Vect<D>::Accumulator> accumulators;
+            dataset.for_each_chunk([&](std::size_t, const auto &records) {
+                for (const auto &record: records) {
+                    if (record.label < 0) {
+                        throw hype::error("Failed to build associative memory: encountered negative label (",
+                                          record.label, ").");
+                    }
+                    if (static_cast<std::size_t>(record.label) >= accumulators.size()) {
+                        accumulators.resize(record.label + 1);
+                    }
+                    if (limits.empty() || accumulators[record.label].size() < limits[record.label]) {
+                        accumulators[record.label].add(record.data);
+                    }
+                }
+            });
+
+            memory.clear();
+            for (const auto &accumulator: accumulators) {
+                memory.insert(accumulator.result());
+            }
+        }
+
+        // Whether a retraining update is anything other than adding the sample to one prototype and subtracting it
+        // from another.
+        static bool scaled(const TrainingOptions &options) {
+            return options.dropout > 0.0 || options.learning_rate != 1.0;
+        }
+
+        // The dropout mask of the n-th sample of an epoch, which is the same however the epoch is split up.
+        static hype::Mask<D> update_mask(const TrainingOptions &options, int epoch, std::size_t n) {
+            return hype::dropout_mask<D>(options.dropout, hype::mix(options.seed, hype::mix(epoch, n)));
+        }
+
+        float train_one_epoch_sharded(Memory &memory, const DatasetView<Encoded, int> &dataset,
+                                      const TrainingOptions &options, int epoch) {
+            std::size_t classes = memory.size();
+            // Per class update, followed by the number of misclassified samples.
+            Shards shards(options.shards, classes * D + 1, options.shard_processes);
+            shards.run([&](std::size_t shard, float *slot) {
+                auto [begin, end] = shards.range(shard, dataset.size());
+                for (std::size_t i = begin; i < end; ++i) {
+                    const auto &[input, label] = dataset[i];
+                    int prediction = predict(memory, input);
+                    if (prediction != label) {
+                        slot[classes * D] += 1;
+                        float *gain = slot + label * D;
+                        float *loss = slot + prediction * D;
+                        auto mask = update_mask(options, epoch, i);
+                        for (std::size_t d = 0; d < D; ++d) {
+                            if (hype::kept<D>(mask, d)) {
+                                gain[d] += input[d];
+                                loss[d] -= input[d];
+                            }
+                        }
+                    }
+                }
+            });
+
+            float wrongs = 0;
+            for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+                wrongs += shards.slot(shard)[classes * D];
+            }
+            if constexpr (shardable) {
+                for (std::size_t c = 0; c < classes; ++c) {
+                    auto &prototype = memory[c];
+                    for (std::size_t d = 0; d < D; ++d) {
+                        data_t update = 0;
+                        for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+                            update += shards.slot(shard)[c * D + d];
+                        }
+                        prototype[d] += options.learning_rate * update;
+                    }
                 }
+            }
+            return wrongs / static_cast<float>(dataset.size()) * 100.0;
+        }
+
+        static std::vector<std::size_t> shuffled_indices(std::size_t size, std::mt19937 &random_source) {
+            std::vector<std::size_t> result(size);
+            std::iota(result.begin(), result.end(), 0);
+            std::shuffle(result.begin(), result.end(), random_source);
+            return result;
+        }
+
+        // Classifies the n-th sample of an epoch and, if it was misclassified, moves it from the predicted prototype to
+        // the prototype of its label. Returns whether it was misclassified.
+        bool retrain(Memory &memory, const Encoded &input, int label, const TrainingOptions &options, int epoch,
+                     std::size_t n) {
+            int prediction = predict(memory, input);
+            if (prediction == label) {
+                return false;
+            }
 
-                if (i % chunk_size == 0) {
-                    //hype::log_info_nl("Processed ", i + 1, " samples.");
+            if constexpr (shardable) {
+                if (scaled(options)) {
+                    auto mask = update_mask(options, epoch, n);
+                    auto &loss = memory[prediction];
+                    auto &gain = memory[label];
+                    for (std::size_t d = 0; d < D; ++d) {
+                        if (hype::kept<D>(mask, d)) {
+                            loss[d] -= options.learning_rate * input[d];
+                            gain[d] += options.learning_rate * input[d];
+                        }
+                    }
+                    return true;
                 }
             }
+            memory[prediction] = sub(memory[prediction], input);
+            memory[label] = add(memory[label], input);
+            return true;
+        }
+
+        float train_one_epoch(Memory &memory, const DatasetView<Encoded, int> &dataset, const TrainingOptions &options,
+                              int epoch) {
+            int wrongs = 0;
+            for (std::size_t i = 0; i < dataset.size(); ++i) {
+                const auto &[input, label] = dataset[i];
+                wrongs += retrain(memory, input, label, options, epoch, i);
+            }
             return static_cast<float>(wrongs) / static_cast<float>(dataset.size()) * 100.0;
         }
 
-        float test(const Dataset<Vect<D>, int> &dataset) {
+        // Visits every streamed sample once, applying the same updates as training in memory. Shuffling cannot draw
+        // a permutation of the whole dataset without random access to it, so it visits the chunks in a random order
+        // and the samples of each chunk in a random order instead.
+        float train_one_epoch(Memory &memory, const ChunkedDataset<Encoded, int> &dataset,
+                              const TrainingOptions &options, int epoch, std::mt19937 &random_source) {
+            std::vector<std::size_t> order(dataset.chunks());
+            std::iota(order.begin(), order.end(), 0);
+            if (options.shuffle) {
+                std::shuffle(order.begin(), order.end(), random_source);
+            }
+
+            std::size_t wrongs = 0;
+            std::size_t n = 0;
+            dataset.for_each_chunk(order, [&](std::size_t, const auto &records) {
+                std::vector<std::size_t> samples(records.size());
+                std::iota(samples.begin(), samples.end(), 0);
+                if (options.shuffle) {
+                    std::shuffle(samples.begin(), samples.end(), random_source);
+                }
+                for (const auto &i: samples) {
+                    wrongs += retrain(memory, records[i].data, records[i].label, options, epoch, n++);
+                }
+            });
+            return static_cast<float>(wrongs) / static_cast<float>(dataset.size()) * 100.0;
+        }
+
+        float test(const Memory &memory, const DatasetView<Encoded, int> &dataset, bool record_latency) {
             int correct = 0;
-            for (const auto &data_point: dataset) {
-                int prediction = predict(data_point.first);
-                if (prediction == data_point.second) {
+            for (const auto &[input, label]: dataset) {
+                int prediction = record_latency ? hype::measure(search_histogram, [&]() {
+                    return predict(memory, input);
+                }) : predict(memory, input);
+                if (prediction == label) {
                     ++correct;
                 }
             }
             return static_cast<float>(correct) / static_cast<float>(dataset.size()) * 100.0;
         }
 
-        int predict(const Vect<D> &input) {
-            return model.associativeMemory.find(input);
+        float test(const Memory &memory, const ChunkedDataset<Encoded, int> &dataset, bool record_latency) {
+            int correct = 0;
+            dataset.for_each_chunk([&](std::size_t, const auto &records) {
+                for (const auto &[input, label]: records) {
+                    int prediction = record_latency ? hype::measure(search_histogram, [&]() {
+                        return predict(memory, input);
+                    }) : predict(memory, input);
+                    if (prediction == label) {
+                        ++correct;
+                    }
+                }
+            });
+            return static_cast<float>(correct) / static_cast<float>(dataset.size()) * 100.0;
+        }
+
+        template<typename V>
+        static int predict(const Memory &memory, const V &input) {
+            return memory.find(input);
         }
 
         bool trainable() {
-            return train_dataset.size() > 0 && test_dataset.size() > 0;
+            return (train_dataset.size() > 0 && test_dataset.size() > 0) || streamed();
+        }
+
+        bool streamed() const {
+            return streamed_train.has_value() && streamed_test.has_value();
         }
 
         std::pair<std::string, std::string>
@@ -158,28 +598,32 @@ namespace hdvr {
             throw hype::error("Could not find a dataset in ", stub);
         }
 
-        bool load_datasets(const std::string &dataset_path, const std::string &extension) {
+        bool read_datasets(const std::string &dataset_path, const std::string &extension, float dataset_fraction) {
             try {
                 auto train_paths = construct_valid_dataset_paths(dataset_path, "train", extension);
                 auto test_paths = construct_valid_dataset_paths(dataset_path, "test", extension);
 
                 try {
-                    if (extension == ".datmem") {
+                    dataset_manifest = datasets_manifest(dataset_path, extension);
+                    if (extension == ".datbin") {
+                        hype::log_info("Loading encoded datasets... ");
+                        train_dataset.load_binary(train_paths.first, train_paths.second);
+                        test_dataset.load_binary(test_paths.first, test_paths.second);
+                        hype::log_info_nl("DONE");
+                        configure_memory(train_dataset, dataset_fraction);
+                    } else if (extension == ".datmem") {
                         hype::log_info("Loading encoded datasets... ");
                         train_dataset.load(train_paths.first, train_paths.second);
                         test_dataset.load(test_paths.first, test_paths.second);
                         hype::log_info_nl("DONE");
+                        configure_memory(train_dataset, dataset_fraction);
                     } else {
-                        hype::log_info("Loading raw datasets... ");
-                        auto train_tmp = Dataset<hype::Vector<F, data_t>, int>(train_paths.first, train_paths.second);
-                        auto test_tmp = Dataset<hype::Vector<F, data_t>, int>(test_paths.first, test_paths.second);
+                        hype::log_info("Loading and encoding training data... ");
+                        train_dataset = encode(train_paths.first, train_paths.second, true, dataset_fraction);
+                        this->dataset_fraction = dataset_fraction;
                         hype::log_info_nl("DONE");
-
-                        hype::log_info("Encoding training data... ");
-                        train_dataset = encode(train_tmp);
-                        hype::log_info_nl("DONE");
-                        hype::log_info("Encoding testing data... ");
-                        test_dataset = encode(test_tmp);
+                        hype::log_info("Loading and encoding testing data... ");
+                        test_dataset = encode(test_paths.first, test_paths.second, false);
                         hype::log_info_nl("DONE");
                     }
                     return true;
@@ -192,29 +636,390 @@ namespace hdvr {
             }
         }
 
+        // What the encoding depends on besides the raw samples: the encoder and the item memories it binds.
+        std::string model_manifest() {
+            std::stringstream ss;
+            ss << "encoder: " << ENCODER_VERSION << "\n"
+               << "encoding: " << encoder << "\n";
+            if (encoder == RANDOM_PROJECTION) {
+                ss << "projection seed: " << projection->projection_seed() << "\n";
+            }
+            ss << "levels: " << L << "\n"
+               << "dimensions: " << D << "\n"
+               << "frequency points: " << F << "\n"
+               << "continuous item memory: " << hype::to_hex(model.continuousItemMemory.hash()) << "\n"
+               << "frequency channel memory: " << hype::to_hex(model.frequencyChannelMemory.hash()) << "\n";
+            if (model.frequencyChannelMemory.masked()) {
+                ss << "channels:";
+                for (auto channel: model.frequencyChannelMemory.channels()) {
+                    ss << " " << channel;
+                }
+                ss << "\n";
+            }
+            return ss.str();
+        }
+
+        // Identifies the datasets with the given extension in `dataset_path` by the hashes of their files.
+        std::string datasets_manifest(const std::string &dataset_path, const std::string &extension) {
+            auto train_paths = construct_valid_dataset_paths(dataset_path, "train", extension);
+            auto test_paths = construct_valid_dataset_paths(dataset_path, "test", extension);
+
+            std::stringstream ss;
+            ss << "train: " << hype::to_hex(hype::hash_file(train_paths.second, hype::hash_file(train_paths.first))) << "\n"
+               << "test: " << hype::to_hex(hype::hash_file(test_paths.second, hype::hash_file(test_paths.first))) << "\n";
+            return ss.str();
+        }
+
+        std::string cache_manifest(const std::string &dataset_path) {
+            return model_manifest() + datasets_manifest(dataset_path, ".csv");
+        }
+
+        // Everything a checkpoint of training `memory` with `options` depends on: the encoding, the datasets, the
+        // prototypes training starts from and every option but the number of epochs and where to checkpoint.
+        std::string training_manifest(const Memory &memory, const TrainingOptions &options) {
+            std::stringstream ss;
+            ss.precision(std::numeric_limits<float>::max_digits10);
+            ss << model_manifest() << dataset_manifest
+               << "prototypes: " << hype::to_hex(memory.hash()) << "\n"
+               << "dataset fraction: " << options.dataset_fraction.value_or(dataset_fraction) << "\n"
+               << "dropout: " << options.dropout << "\n"
+               << "learning rate: " << options.learning_rate << "\n"
+               << "validation fraction: " << options.validation_fraction << "\n"
+               << "patience: " << options.patience << "\n"
+               << "min delta: " << options.min_delta << "\n"
+               << "shuffle: " << options.shuffle << "\n"
+               << "evaluation interval: " << options.evaluation_interval << "\n"
+               << "seed: " << options.seed << "\n"
+               << "shards: " << options.shards << "\n";
+            return ss.str();
+        }
+
+        bool load_cached_datasets(const std::string &cache_path, const std::string &manifest, float dataset_fraction) {
+            std::string manifest_path = cache_path + "/./cache.key";
+            try {
+                if (!hype::is_file(manifest_path) || hype::read_file_directly(manifest_path) != manifest) {
+                    return false;
+                }
+            } catch (std::runtime_error &e) {
+                return false;
+            }
+            return read_datasets(cache_path, ".datbin", dataset_fraction);
+        }
+
     public:
 
-        HDVR(Model<L, D, F, S> &model_) : model(model_) {}
+        // A prototype of sparse block codes keeps one index per block and no weight, so moving a sample between two of
+        // them overwrites blocks rather than shifting votes. Such models can only be bundled.
+        static constexpr bool retrainable = !hype::is_sparse_block_v<Vect<D>>;
+
+        // The random projection is drawn from `projection_seed`; the ID-level encoder uses the model's item memories.
+        HDVR(Model<L, D, F, S> &model_, Encoder encoder_ = ID_LEVEL, std::uint64_t projection_seed = 0)
+                : model(model_), encoder(encoder_) {
+            if (encoder == RANDOM_PROJECTION) {
+                projection.emplace(projection_seed);
+            } else if (encoder == BOUND_PAIRS) {
+                if constexpr (std::is_same_v<Vect<D>, hype::Vector<D, data_t>>) {
+                    table.emplace(model);
+                } else {
+                    throw hype::error("The bound-pair table needs bipolar item memories.");
+                }
+            }
+        }
+
+        Vect<D> encode(const hype::Vector<F, data_t> &data_point) const {
+            if (encoder == RANDOM_PROJECTION) {
+                return std::move(encode(std::vector<const hype::Vector<F, data_t> *>{&data_point}).front());
+            }
+            if constexpr (std::is_same_v<Vect<D>, hype::Vector<D, data_t>>) {
+                if (encoder == BOUND_PAIRS) {
+                    return table->encode(data_point);
+                }
+            }
+
+            typename Vect<D>::Accumulator accumulator;
+
+            model.frequencyChannelMemory.for_each_channel([&](std::size_t i, const Vect<D> &channel) {
+                if (data_point[i] < MIN_FREQUENCY || data_point[i] > MAX_FREQUENCY) {
+                    throw hype::error("Frequency of ", data_point[i], " is outside expected range of [", MIN_FREQUENCY,
+                                      ", ", MAX_FREQUENCY, "]");
+                }
+                int bin = frequency_bin(data_point[i], model.continuousItemMemory.size());
+                accumulator.add_product(channel, model.continuousItemMemory[bin]);
+            });
+
+            return accumulator.result();
+        }
+
+        // Bins of a frame's channels, in the form encode_delta() keeps between frames; channels masked out get -1.
+        std::vector<int> bins(const hype::Vector<F, data_t> &frame) const {
+            std::vector<int> result(F, -1);
+            model.frequencyChannelMemory.for_each_channel([&](std::size_t i, const Vect<D> &) {
+                if (frame[i] < MIN_FREQUENCY || frame[i] > MAX_FREQUENCY) {
+                    throw hype::error("Frequency of ", frame[i], " is outside expected range of [", MIN_FREQUENCY,
+                                      ", ", MAX_FREQUENCY, "]");
+                }
+                result[i] = frequency_bin(frame[i], model.continuousItemMemory.size());
+            });
+            return result;
+        }
+
+        // Encodes `frame` as an update of `encoded`, the encoding of the previous frame, whose bins are `bins`: only
+        // the channels whose bin changed are rebound, from their old level to the new one, so the cost grows with the
+        // number of changed channels rather than with F. When `bins` is empty, or more than a fraction `threshold` of
+        // the kept channels changed, the frame is encoded in full instead, as it is when the mask no longer matches
+        // `bins`. Updates `bins` and `encoded` to describe `frame`, and returns how many channels changed. Throws
+        // std::invalid_argument if `bins` is neither empty nor F valid bins.
+        std::size_t encode_delta(const hype::Vector<F, data_t> &frame, std::vector<int> &bins,
+                                 Vect<D> &encoded, float threshold = DELTA_THRESHOLD) const {
+            if (!bins.empty()) {
+                if (bins.size() != F) {
+                    throw std::invalid_argument(hype::concat("Expected bins of ", F, " channels, got ", bins.size(), "."));
+                }
+                int levels = static_cast<int>(model.continuousItemMemory.size());
+                for (auto bin: bins) {
+                    if (bin < -1 || bin >= levels) {
+                        throw std::invalid_argument(hype::concat("Bin ", bin, " is outside [-1, ", levels, ")."));
+                    }
+                }
+            }
+
+            std::vector<int> next = this->bins(frame);
+            std::vector<std::size_t> changed;
+            bool remasked = false;
+            for (std::size_t i = 0; i < F; ++i) {
+                if (bins.empty() || next[i] != bins[i]) {
+                    changed.push_back(i);
+                    remasked = remasked || bins.empty() || bins[i] < 0 || next[i] < 0;
+                }
+            }
+            std::size_t kept = model.frequencyChannelMemory.masked() ? model.frequencyChannelMemory.channels().size()
+                                                                      : model.frequencyChannelMemory.size();
+
+            // The random projection has no bound pairs to rebind, and bundled binary vectors keep no counts to update.
+            bool incremental = encoder != RANDOM_PROJECTION && std::is_same_v<Vect<D>, hype::Vector<D, data_t>> &&
+                               !remasked && changed.size() <= threshold * kept;
+            if (!incremental) {
+                encoded = encode(frame);
+            } else if constexpr (std::is_same_v<Vect<D>, hype::Vector<D, data_t>>) {
+                typename Vect<D>::Accumulator accumulator(encoded, kept);
+                for (auto i: changed) {
+                    accumulator.replace_product(model.frequencyChannelMemory[i], model.continuousItemMemory[bins[i]],
+                                                model.continuousItemMemory[next[i]]);
+                }
+                encoded = accumulator.result();
+            }
+            bins = std::move(next);
+            return changed.size();
+        }
+
+        // Encodes a raw dataset held in memory, in batches of ENCODE_BATCH samples spread across all cores.
+        Dataset<Encoded, int> encode(const Dataset<hype::Vector<F, data_t>, int> &dataset) {
+            refresh_bound_pairs();
+            std::vector<Encoded> encoded(dataset.size());
+            std::size_t batches = (dataset.size() + ENCODE_BATCH - 1) / ENCODE_BATCH;
+            std::atomic<std::size_t> next(0);
+            std::mutex mutex;
+            std::exception_ptr failure = nullptr;
+
+            std::vector<std::thread> threads;
+            std::size_t workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), batches);
+            for (std::size_t worker = 0; worker < workers; ++worker) {
+                threads.emplace_back([&]() {
+                    std::vector<const hype::Vector<F, data_t> *> inputs;
+                    for (std::size_t b = next++; b < batches; b = next++) {
+                        try {
+                            std::size_t begin = b * ENCODE_BATCH;
+                            std::size_t end = std::min(begin + ENCODE_BATCH, dataset.size());
+                            inputs.clear();
+                            for (std::size_t i = begin; i < end; ++i) {
+                                inputs.push_back(&dataset[i].first);
+                            }
+                            auto batch = encode(inputs);
+                            for (std::size_t i = begin; i < end; ++i) {
+                                encoded[i] = Encoded(std::move(batch[i - begin]));
+                            }
+                        } catch (...) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (failure == nullptr) {
+                                failure = std::current_exception();
+                            }
+                            next = batches;
+                        }
+                    }
+                });
+            }
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            if (failure != nullptr) {
+                std::rethrow_exception(failure);
+            }
+
+            Dataset<Encoded, int> result;
+            result.reserve(dataset.size());
+            for (std::size_t i = 0; i < dataset.size(); ++i) {
+                result.add({std::move(encoded[i]), dataset[i].second});
+            }
+            return result;
+        }
+
+        // The table behind the bound-pair encoder, e.g. to fill it up front or limit its memory. It packs the item
+        // memories as they are now; encoding a dataset packs them again if they change later on.
+        BoundPairTable<L, D, F> &bound_pairs() {
+            if (!table) {
+                throw hype::error("Bound pairs are only kept by the ", BOUND_PAIRS, " encoder.");
+            }
+            refresh_bound_pairs();
+            return *table;
+        }
+
+        // Index of the prototype closest to an encoded sample. Like encode(), safe to call from several threads at once
+        // as long as the model does not change meanwhile.
+        template<typename V>
+        int predict(const V &input) const {
+            return predict(model.associativeMemory, input);
+        }
+
+        // Classifies a single raw sample.
+        int classify(const hype::Vector<F, data_t> &data_point) {
+            if (!recording_latency) {
+                return predict(encode(data_point));
+            }
+            auto encoded = hype::measure(encode_histogram, [&]() { return encode(data_point); });
+            return hype::measure(search_histogram, [&]() { return predict(encoded); });
+        }
+
+        // Records how long each encoding and each search takes from now on, e.g. to watch tail latencies.
+        void record_latency(bool enabled) {
+            recording_latency = enabled;
+        }
+
+        const hype::LatencyHistogram &encode_latency() const {
+            return encode_histogram;
+        }
+
+        const hype::LatencyHistogram &search_latency() const {
+            return search_histogram;
+        }
 
         bool load_datasets(const std::string &dataset_path, float dataset_fraction = 1.0) {
-            std::array<std::string, 2> extensions{".datmem", ".csv"};
+            std::array<std::string, 3> extensions{".datbin", ".datmem", ".csv"};
             for (const auto &extension: extensions) {
-                if (load_datasets(dataset_path, extension)) {
+                if (read_datasets(dataset_path, extension, dataset_fraction)) {
                     hype::log_info_nl("Loaded ", train_dataset.size(), " training samples, and ", test_dataset.size(), " testing samples.");
-                    configure_memory(train_dataset, dataset_fraction);
                     return true;
                 }
             }
             return false;
         }
 
+        // Loads the raw dataset in `dataset_path`, reusing an encoding from `cache_path` when one exists for the
+        // exact same raw files, item memories and encoder. Each encoding lives in its own subdirectory named after
+        // the hash of those inputs, so stale encodings are never picked up and several can coexist.
+        bool load_datasets(const std::string &dataset_path, const std::string &cache_path, float dataset_fraction = 1.0) {
+            std::string manifest;
+            std::string raw_manifest;
+            try {
+                raw_manifest = datasets_manifest(dataset_path, ".csv");
+                manifest = model_manifest() + raw_manifest;
+            } catch (std::runtime_error &e) {
+                hype::log_error_nl(e.what());
+                return false;
+            }
+
+            std::string cache_entry = cache_path + "/./" + hype::to_hex(hype::hash(manifest));
+            bool cached = load_cached_datasets(cache_entry, manifest, dataset_fraction);
+            if (!cached && !read_datasets(dataset_path, ".csv", dataset_fraction)) {
+                return false;
+            }
+            // Cached or not, these are the raw datasets.
+            dataset_manifest = raw_manifest;
+
+            hype::log_info_nl("Loaded ", train_dataset.size(), " training samples, and ", test_dataset.size(), " testing samples.");
+
+            if (!cached) {
+                try {
+                    hype::make_directories(cache_entry);
+                } catch (std::runtime_error &e) {
+                    hype::log_error_nl("Failed to cache dataset: ", e.what());
+                    return true;
+                }
+                if (save_datasets(cache_entry)) {
+                    try {
+                        // Written last, so that an interrupted save is never mistaken for a valid cache entry.
+                        hype::save_file_directly(cache_entry + "/./cache.key", manifest);
+                    } catch (std::runtime_error &e) {
+                        hype::log_error_nl("Failed to cache dataset: ", e.what());
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Like load_datasets(), but leaves the encoded datasets on disk and streams them through at most `memory_budget`
+        // bytes of memory whenever they are used, so their size is bounded by the disk rather than by memory. The raw
+        // dataset is encoded straight to disk the first time; later calls reuse that encoding from `cache_path`.
+        bool stream_datasets(const std::string &dataset_path, const std::string &cache_path, std::size_t memory_budget,
+                             float dataset_fraction = 1.0) {
+            try {
+                std::string manifest = cache_manifest(dataset_path);
+                std::string cache_entry = cache_path + "/./" + hype::to_hex(hype::hash(manifest));
+                std::string manifest_path = cache_entry + "/./stream.key";
+                std::string train_path = cache_entry + "/./train.datchunk";
+                std::string test_path = cache_entry + "/./test.datchunk";
+
+                bool cached = hype::is_file(manifest_path) && hype::read_file_directly(manifest_path) == manifest &&
+                              hype::is_file(train_path) && hype::is_file(test_path);
+                if (!cached) {
+                    hype::make_directories(cache_entry);
+                    auto train_paths = construct_valid_dataset_paths(dataset_path, "train", ".csv");
+                    auto test_paths = construct_valid_dataset_paths(dataset_path, "test", ".csv");
+
+                    hype::log_info("Encoding training data to disk... ");
+                    ChunkedDatasetWriter<Encoded, int> train_writer(train_path);
+                    encode(train_paths.first, train_paths.second, hype::read_file<int>(train_paths.second), true,
+                           dataset_fraction, [&](Encoded &&sample, int label) { train_writer.add(sample, label); });
+                    train_writer.close();
+                    hype::log_info_nl("DONE");
+
+                    hype::log_info("Encoding testing data to disk... ");
+                    ChunkedDatasetWriter<Encoded, int> test_writer(test_path);
+                    encode(test_paths.first, test_paths.second, hype::read_file<int>(test_paths.second), false, 1.0,
+                           [&](Encoded &&sample, int label) { test_writer.add(sample, label); });
+                    test_writer.close();
+                    hype::log_info_nl("DONE");
+
+                    // Written last, so that an interrupted encoding is never mistaken for a valid one.
+                    hype::save_file_directly(manifest_path, manifest);
+                }
+
+                streamed_train.emplace(train_path, memory_budget);
+                streamed_test.emplace(test_path, memory_budget);
+                if (cached) {
+                    hype::log_info("Bundling prototypes from disk... ");
+                    configure_memory(model.associativeMemory, *streamed_train, dataset_fraction);
+                    hype::log_info_nl("DONE");
+                }
+                this->dataset_fraction = dataset_fraction;
+            } catch (std::runtime_error &e) {
+                hype::log_error_nl(e.what());
+                streamed_train.reset();
+                streamed_test.reset();
+                return false;
+            }
+
+            hype::log_info_nl("Streaming ", streamed_train->size(), " training samples, and ", streamed_test->size(),
+                              " testing samples, ", streamed_train->chunk_size(), " samples at a time.");
+            return true;
+        }
+
         bool save_datasets(const std::string &dataset_path) {
-            auto train_paths = construct_dataset_paths(dataset_path, "train", ".datmem");
-            auto test_paths = construct_dataset_paths(dataset_path, "test", ".datmem");
+            auto train_paths = construct_dataset_paths(dataset_path, "train", ".datbin");
+            auto test_paths = construct_dataset_paths(dataset_path, "test", ".datbin");
 
             try {
-                train_dataset.save(train_paths.first, train_paths.second);
-                test_dataset.save(test_paths.first, test_paths.second);
+                train_dataset.save_binary(train_paths.first, train_paths.second);
+                test_dataset.save_binary(test_paths.first, test_paths.second);
                 return true;
             } catch (std::runtime_error &e) {
                 hype::log_error_nl("Failed to save dataset: ", e.what());
@@ -223,35 +1028,385 @@ namespace hdvr {
         }
 
         Metrics train(int epochs) {
+            TrainingOptions options;
+            options.epochs = epochs;
+            return train(options);
+        }
+
+        Metrics train(const TrainingOptions &options) {
+            return train(model.associativeMemory, options, false);
+        }
+
+        // Recall (in percent) of `index` against the exact scan over the prototypes on the test set, and the average
+        // fraction of the prototypes it compared each sample against.
+        std::pair<float, float> index_recall(hype::LshIndex<Vect<D>> &index) {
+            std::size_t agreements = 0;
+            std::size_t candidates = 0;
+            for (const auto &[input, label]: test_dataset) {
+                agreements += index.find(input) == static_cast<std::size_t>(predict(input));
+                candidates += index.compared();
+            }
+            return {static_cast<float>(agreements) / static_cast<float>(test_dataset.size()) * 100.0f,
+                    static_cast<float>(candidates) /
+                    static_cast<float>(test_dataset.size() * model.associativeMemory.size())};
+        }
+
+        // Trains one independent copy of the current prototypes per configuration, concurrently on up to `workers`
+        // threads (one per core by default). The encoded datasets are loaded once and shared read-only, and the model
+        // itself is left untouched. Sharded configurations run their shards in-process, as forking is unsafe here.
+        std::vector<Metrics> sweep(const std::vector<TrainingOptions> &configurations, std::size_t workers = 0) {
+            if (workers == 0) {
+                workers = std::max(1u, std::thread::hardware_concurrency());
+            }
+            workers = std::min(workers, configurations.size());
+
+            std::vector<std::optional<Metrics>> results(configurations.size());
+            std::atomic<std::size_t> next(0);
+            std::mutex mutex;
+            std::exception_ptr failure = nullptr;
+
+            std::vector<std::thread> threads;
+            for (std::size_t worker = 0; worker < workers; ++worker) {
+                threads.emplace_back([&]() {
+                    for (std::size_t i = next++; i < configurations.size(); i = next++) {
+                        try {
+                            TrainingOptions options = configurations[i];
+                            options.shard_processes = false;
+                            Memory memory = model.associativeMemory;
+                            Metrics metrics = train(memory, options, true);
+
+                            std::lock_guard<std::mutex> lock(mutex);
+                            hype::log_info_nl("Configuration ", i + 1, "/", configurations.size(), ": ",
+                                              describe(options), ": accuracy: ",
+                                              metrics.last_accuracy().value_or(0), "%");
+                            results[i] = std::move(metrics);
+                        } catch (...) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (failure == nullptr) {
+                                failure = std::current_exception();
+                            }
+                            next = configurations.size();
+                        }
+                    }
+                });
+            }
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            if (failure != nullptr) {
+                std::rethrow_exception(failure);
+            }
+
+            std::vector<Metrics> metrics;
+            metrics.reserve(results.size());
+            for (auto &result: results) {
+                metrics.emplace_back(std::move(*result));
+            }
+            return metrics;
+        }
+
+    private:
+        std::string describe(const TrainingOptions &options) {
+            std::stringstream ss;
+            ss << "epochs: " << options.epochs << ", levels: " << L << ", dimensions: " << D
+               << ", frequency points: " << F << ", dataset fraction: "
+               << options.dataset_fraction.value_or(dataset_fraction) << ", dropout: " << options.dropout
+               << ", learning rate: " << options.learning_rate << ", validation fraction: "
+               << options.validation_fraction << ", patience: " << options.patience << ", min delta: "
+               << options.min_delta << ", shuffle: " << options.shuffle << ", evaluation interval: "
+               << options.evaluation_interval << ", seed: " << options.seed << ", shards: " << options.shards;
+            return ss.str();
+        }
+
+        // Retrains `memory`. With `quiet` set, nothing is logged and no latencies are recorded, so that several runs
+        // can share this instance.
+        Metrics train(Memory &memory, const TrainingOptions &options, bool quiet) {
             if (!trainable()) {
                 throw hype::error("Could not train model. Did you forget to setup datasets?");
             }
+            if (streamed()) {
+                return train_streamed(memory, options, quiet);
+            }
+            if (options.validation_fraction < 0.0 || options.validation_fraction >= 1.0) {
+                throw hype::error("Validation fraction must be in [0, 1), but was ", options.validation_fraction);
+            }
+            if (options.dropout < 0.0 || options.dropout >= 1.0) {
+                throw hype::error("Dropout must be in [0, 1), but was ", options.dropout);
+            }
+            if (options.shards > 0 && !shardable) {
+                throw hype::error("Sharded training requires hypervectors whose bundling is a sum.");
+            }
+            if (scaled(options) && !shardable) {
+                throw hype::error("Dropout and learning rates require hypervectors whose bundling is a sum.");
+            }
+            if (options.epochs > 0 && !retrainable) {
+                throw hype::error("Sparse block codes cannot be retrained. Train for 0 epochs to only bundle them.");
+            }
 
-            std::stringstream ss;
-            ss << "\"" << "Training: epochs: " << epochs << ", levels: " << L << ", dimensions: " << D << ", frequency points: "
-               << F << "\"";
-            Metrics metrics(ss.str());
+            auto progress = [&](const auto &...args) {
+                if (!quiet) {
+                    hype::log_info_nl(args...);
+                }
+            };
+            bool record_latency = recording_latency && !quiet;
+
+            Metrics metrics("\"Training: " + describe(options) + "\"");
+            std::string manifest;
+            std::optional<Checkpoint<Memory>> resumed;
+            if (!options.checkpoint_path.empty()) {
+                manifest = training_manifest(memory, options);
+                if (options.resume) {
+                    resumed = Checkpointer<Memory>::load(options.checkpoint_path, manifest);
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            if (resumed.has_value()) {
+                start -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<float>(resumed->seconds));
+            }
+            auto elapsed = [&]() {
+                return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            // The split is drawn again on resumption, so that it matches the checkpointed run.
+            std::mt19937 random_source(options.seed);
+            float fraction = options.dataset_fraction.value_or(dataset_fraction);
+            DatasetView<Encoded, int> training = train_dataset;
+            std::optional<DatasetView<Encoded, int>> validation;
+            if (options.validation_fraction > 0.0) {
+                auto shuffled = train_dataset.permute(shuffled_indices(train_dataset.size(), random_source));
+                auto held_out = static_cast<std::size_t>(train_dataset.size() * options.validation_fraction);
+                if (held_out == 0) {
+                    throw hype::error("Validation fraction of ", options.validation_fraction, " leaves no samples for validation.");
+                }
+                validation = shuffled.slice(0, held_out);
+                training = shuffled.slice(held_out, shuffled.size());
+
+                // The prototypes must not have seen the validation samples.
+                if (!resumed.has_value()) {
+                    configure_memory(memory, training, fraction, options);
+                }
+                progress("Holding out ", held_out, " training samples for validation.");
+            } else if ((options.dataset_fraction.has_value() || options.shards > 0) && !resumed.has_value()) {
+                // Loading bundled the prototypes in this process; sharded runs bundle them again across the shards.
+                configure_memory(memory, training, fraction, options);
+            }
+
+            float accuracy = 0;
+            std::optional<float> validation_accuracy;
+            float best_accuracy = 0;
+            int best_epoch = 0;
+            int evaluations_since_best = 0;
+            int first_epoch = 1;
+            bool stopped = false;
+            Memory best_memory;
+
+            if (resumed.has_value()) {
+                std::stringstream random_state(resumed->random_state);
+                random_state >> random_source;
+                memory = std::move(resumed->memory);
+                best_memory = std::move(resumed->best_memory);
+                metrics = std::move(resumed->metrics);
+                best_accuracy = resumed->best_accuracy;
+                best_epoch = resumed->best_epoch;
+                evaluations_since_best = resumed->evaluations_since_best;
+                first_epoch = resumed->epoch + 1;
+                stopped = resumed->stopped;
+                progress("Resuming from checkpoint after epoch ", resumed->epoch, ".");
+            } else {
+                progress("Running test... ");
+                accuracy = test(memory, test_dataset, record_latency);
+                if (validation.has_value()) {
+                    validation_accuracy = test(memory, *validation, false);
+                }
+                progress("Accuracy before training: ", accuracy, "%");
+                metrics.log(0, 0, accuracy, validation_accuracy, elapsed());
+
+                best_accuracy = validation_accuracy.value_or(0);
+                best_memory = memory;
+            }
+
+            std::optional<Checkpointer<Memory>> checkpointer;
+            if (!options.checkpoint_path.empty()) {
+                checkpointer.emplace(options.checkpoint_path, options.checkpoint_interval, options.checkpoint_seconds);
+            }
+            // Only copies the state; the checkpointer serialises it on its own thread.
+            auto snapshot = [&](int epoch) {
+                Checkpoint<Memory> state;
+                state.manifest = manifest;
+                state.epoch = epoch;
+                state.stopped = stopped;
+                state.seconds = elapsed();
+                std::stringstream random_state;
+                random_state << random_source;
+                state.random_state = random_state.str();
+                state.best_accuracy = best_accuracy;
+                state.best_epoch = best_epoch;
+                state.evaluations_since_best = evaluations_since_best;
+                state.memory = memory;
+                if (validation.has_value()) {
+                    state.best_memory = best_memory;
+                }
+                state.metrics = metrics;
+                return state;
+            };
+
+            // Shard workers are forked, which must not happen while the writer may hold a lock. So that the writer is
+            // idle by then, a checkpoint taken before a forking epoch is only submitted once its workers have exited.
+            bool forking = options.shards > 0 && options.shard_processes;
+            std::optional<Checkpoint<Memory>> deferred;
+
+            int epoch = first_epoch - 1;
+            for (int i = first_epoch; i <= options.epochs && !stopped; ++i) {
+                epoch = i;
+                auto epoch_data = options.shuffle ? training.permute(shuffled_indices(training.size(), random_source))
+                                                  : training;
+                if (checkpointer.has_value() && forking) {
+                    checkpointer->stop();
+                }
+                float error = options.shards > 0 ? train_one_epoch_sharded(memory, epoch_data, options, i)
+                                                 : train_one_epoch(memory, epoch_data, options, i);
+                if (deferred.has_value()) {
+                    checkpointer->submit(std::move(*deferred));
+                    deferred.reset();
+                }
+
+                bool evaluate = i % std::max(1, options.evaluation_interval) == 0 || i == options.epochs;
+                if (!evaluate) {
+                    progress("[Epoch: ", i, "]: error: ", error, "%");
+                    metrics.log(i, error, std::nullopt, std::nullopt, elapsed());
+                } else if (!validation.has_value()) {
+                    accuracy = test(memory, test_dataset, record_latency);
+                    progress("[Epoch: ", i, "]: error: ", error, "% – accuracy: ", accuracy, "%");
+                    metrics.log(i, error, accuracy, std::nullopt, elapsed());
+                } else {
+                    accuracy = test(memory, test_dataset, record_latency);
+                    validation_accuracy = test(memory, *validation, false);
+                    progress("[Epoch: ", i, "]: error: ", error, "% – accuracy: ", accuracy,
+                             "% – validation accuracy: ", *validation_accuracy, "%");
+                    metrics.log(i, error, accuracy, validation_accuracy, elapsed());
+
+                    if (*validation_accuracy > best_accuracy + options.min_delta) {
+                        best_accuracy = *validation_accuracy;
+                        best_epoch = i;
+                        evaluations_since_best = 0;
+                        best_memory = memory;
+                    } else if (++evaluations_since_best >= options.patience) {
+                        progress("Stopping early after epoch ", i, "; no improvement since epoch ", best_epoch, ".");
+                        metrics.note(hype::concat("Stopped early after epoch ", i));
+                        stopped = true;
+                    }
+                }
+
+                if (checkpointer.has_value() && !stopped && i < options.epochs && checkpointer->due(i)) {
+                    if (forking) {
+                        deferred = snapshot(i);
+                    } else {
+                        checkpointer->submit(snapshot(i));
+                    }
+                }
+            }
 
-            hype::log_info_nl("Running test... ");
-            float accuracy = test(test_dataset);
-            hype::log_info_nl("Accuracy before training: ", accuracy, "%");
-            metrics.log(0, 0, accuracy);
+            // Taken before the best prototypes are restored, so that a resumed run can train on from the last epoch.
+            if (checkpointer.has_value()) {
+                checkpointer->submit(snapshot(epoch));
+            }
 
-            for (int i = 0; i < epochs; ++i) {
-                hype::log_info("[Epoch: ", i + 1, "]: ");
-                float error = train_one_epoch(train_dataset);
-                accuracy = test(test_dataset);
-                hype::log_info_nl("error: ", error, "% – accuracy: ", accuracy, "%");
-                metrics.log(i + 1, error, accuracy);
+            if (validation.has_value()) {
+                memory = best_memory;
+                progress("Using prototypes from epoch ", best_epoch, " with validation accuracy ", best_accuracy, "%.");
+                metrics.note(hype::concat("Best epoch: ", best_epoch));
             }
 
+            if (!quiet) {
+                report_latency(metrics);
+            }
             return metrics;
         }
 
-    private:
+        // Retrains `memory` on the streamed datasets. Validation splits, shards and checkpoints all need the training
+        // set in memory, so they are not available here.
+        Metrics train_streamed(Memory &memory, const TrainingOptions &options, bool quiet) {
+            if (options.validation_fraction > 0.0 || options.shards > 0 || !options.checkpoint_path.empty()) {
+                throw hype::error("Validation splits, shards and checkpoints are not supported on streamed datasets.");
+            }
+            if (options.dropout < 0.0 || options.dropout >= 1.0) {
+                throw hype::error("Dropout must be in [0, 1), but was ", options.dropout);
+            }
+            if (scaled(options) && !shardable) {
+                throw hype::error("Dropout and learning rates require hypervectors whose bundling is a sum.");
+            }
+            if (options.epochs > 0 && !retrainable) {
+                throw hype::error("Sparse block codes cannot be retrained. Train for 0 epochs to only bundle them.");
+            }
+
+            auto progress = [&](const auto &...args) {
+                if (!quiet) {
+                    hype::log_info_nl(args...);
+                }
+            };
+            bool record_latency = recording_latency && !quiet;
+
+            Metrics metrics("\"Training (streamed): " + describe(options) + "\"");
+            auto start = std::chrono::steady_clock::now();
+            auto elapsed = [&]() {
+                return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            std::mt19937 random_source(options.seed);
+            if (options.dataset_fraction.has_value()) {
+                configure_memory(memory, *streamed_train, *options.dataset_fraction);
+            }
+
+            progress("Running test... ");
+            float accuracy = test(memory, *streamed_test, record_latency);
+            progress("Accuracy before training: ", accuracy, "%");
+            metrics.log(0, 0, accuracy, std::nullopt, elapsed());
+
+            for (int i = 1; i <= options.epochs; ++i) {
+                float error = train_one_epoch(memory, *streamed_train, options, i, random_source);
+                if (i % std::max(1, options.evaluation_interval) == 0 || i == options.epochs) {
+                    accuracy = test(memory, *streamed_test, record_latency);
+                    progress("[Epoch: ", i, "]: error: ", error, "% – accuracy: ", accuracy, "%");
+                    metrics.log(i, error, accuracy, std::nullopt, elapsed());
+                } else {
+                    progress("[Epoch: ", i, "]: error: ", error, "%");
+                    metrics.log(i, error, std::nullopt, std::nullopt, elapsed());
+                }
+            }
+
+            if (!quiet) {
+                report_latency(metrics);
+            }
+            return metrics;
+        }
+
+        void report_latency(Metrics &metrics) {
+            if (encode_histogram.count() > 0) {
+                hype::log_info_nl("Encode latency: ", encode_histogram.summary());
+                metrics.latency("encode", encode_histogram);
+            }
+            if (search_histogram.count() > 0) {
+                hype::log_info_nl("Search latency: ", search_histogram.summary());
+                metrics.latency("search", search_histogram);
+            }
+        }
+
         Model<L, D, F, S> &model;
-        Dataset<Vect<D>, int> train_dataset;
-        Dataset<Vect<D>, int> test_dataset;
+        Encoder encoder;
+        std::optional<hype::RandomProjection<F, D>> projection;
+        std::optional<BoundPairTable<L, D, F>> table;
+        Dataset<Encoded, int> train_dataset;
+        Dataset<Encoded, int> test_dataset;
+        std::optional<ChunkedDataset<Encoded, int>> streamed_train;
+        std::optional<ChunkedDataset<Encoded, int>> streamed_test;
+        float dataset_fraction = 1.0;
+        // Identifies the datasets last loaded, for checkpoints to tell which datasets they were taken on.
+        std::string dataset_manifest;
+        bool recording_latency = false;
+        hype::LatencyHistogram encode_histogram;
+        hype::LatencyHistogram search_histogram;
     };
 
 } // namespace hdvr
\ No newline at end of file
@@ -0,0 +1,162 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "HDVR.h"
+#include "Model.h"
+#include "hype/EpochPtr.h"
+#include "hype/Histogram.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace hdvr {
+
+    // Serves predictions from the model saved in a directory and picks up new versions saved there while it runs. A
+    // loader thread polls the directory's marker, which Model::save() switches only once a version is complete; when
+    // it names another version, the loader loads that one next to the serving one and publishes it through an
+    // EpochPtr. Queries never lock or wait: each runs on the version current when it started, and a version is
+    // destroyed once the last query on it has finished.
+    template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
+    class LiveModel {
+    private:
+        struct Version {
+            Version(const std::string &path, const std::string &saved, std::uint64_t number_)
+                    : model(path, saved), hdvr(model), number(number_) {}
+
+            Model<L, D, F, S> model;
+            HDVR<L, D, F, S> hdvr;
+            std::uint64_t number;
+        };
+
+    public:
+        using Snapshot = typename hype::EpochPtr<Version>::Snapshot;
+
+        LiveModel(const std::string &path_, std::chrono::milliseconds interval_)
+                : path(path_), interval(interval_), saved(Model<L, D, F, S>::saved_version(path)),
+                  current(load(saved, 0)) {
+            loader = std::thread([this]() { run(); });
+        }
+
+        LiveModel(const LiveModel &) = delete;
+
+        LiveModel &operator=(const LiveModel &) = delete;
+
+        ~LiveModel() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            loader.join();
+        }
+
+        int classify(const hype::Vector<F, data_t> &sample) const {
+            auto version = current.read();
+            return version->hdvr.predict(version->hdvr.encode(sample));
+        }
+
+        // Pins the current version, e.g. to answer several queries from the same one. See EpochPtr::Snapshot.
+        Snapshot snapshot() const {
+            return current.read();
+        }
+
+        // Loads and publishes the saved model now, whether or not it changed. Returns false if it could not be loaded.
+        bool reload() {
+            std::lock_guard<std::mutex> lock(reloading);
+            std::string version = Model<L, D, F, S>::saved_version(path);
+            auto start = std::chrono::steady_clock::now();
+            std::unique_ptr<Version> next;
+            try {
+                next = load(version, current.version() + 1);
+            } catch (std::runtime_error &e) {
+                hype::log_error_nl("Failed to reload model: ", e.what());
+                return false;
+            }
+            auto loaded = std::chrono::steady_clock::now() - start;
+            auto grace_period = current.publish(std::move(next));
+
+            std::lock_guard<std::mutex> stats_lock(mutex);
+            saved = version;
+            load_histogram.record(loaded);
+            grace_histogram.record(grace_period);
+            return true;
+        }
+
+        // Number of versions published after the first.
+        [[nodiscard]]
+        std::uint64_t version() const {
+            return current.version();
+        }
+
+        // How long loading each new version took, while the previous one kept serving.
+        hype::LatencyHistogram load_latency() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return load_histogram;
+        }
+
+        // How long each swap waited for queries on the previous version to finish before destroying it.
+        hype::LatencyHistogram grace_periods() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return grace_histogram;
+        }
+
+    private:
+        std::unique_ptr<Version> load(const std::string &version, std::uint64_t number) const {
+            try {
+                return std::make_unique<Version>(path, version, number);
+            } catch (std::runtime_error &e) {
+                throw hype::error("Could not load model from ", path, ": ", e.what());
+            }
+        }
+
+        // Models saved before versions existed have no marker, so they are only reloaded by reload().
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wake.wait_for(lock, interval, [this]() { return stopping; })) {
+                std::string version = Model<L, D, F, S>::saved_version(path);
+                if (!version.empty() && version != saved) {
+                    lock.unlock();
+                    reload();
+                    lock.lock();
+                }
+            }
+        }
+
+        std::string path;
+        std::chrono::milliseconds interval;
+        // The version loaded last.
+        std::string saved;
+        hype::EpochPtr<Version> current;
+        hype::LatencyHistogram load_histogram;
+        hype::LatencyHistogram grace_histogram;
+        std::mutex reloading;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread loader;
+    };
+
+} // namespace hdvr
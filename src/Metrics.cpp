@@ -20,6 +20,9 @@
 #include "Metrics.h"
 #include "hype/Utils.h"
 
+#include <array>
+#include <limits>
+
 namespace hdvr {
 
     Metrics::Metrics(const std::string &header_) : header(header_) {}
@@ -36,17 +39,28 @@ namespace hdvr {
         std::vector<std::string> result;
 
         std::stringstream ss;
-        ss << "epoch,error,accuracy";
+        ss << "epoch,error,accuracy,validation_accuracy,seconds";
         result.emplace_back(ss.str());
         ss.str("");
 
         for (const auto &dp: data) {
-            ss << dp.epoch << "," << dp.error << "," << dp.accuracy;
+            ss << dp.epoch << "," << dp.error << ",";
+            if (dp.accuracy.has_value()) {
+                ss << *dp.accuracy;
+            }
+            ss << ",";
+            if (dp.validation_accuracy.has_value()) {
+                ss << *dp.validation_accuracy;
+            }
+            ss << "," << dp.seconds;
             result.emplace_back(ss.str());
             ss.str("");
         }
 
         result.emplace_back(header);
+        for (const auto &note: notes) {
+            result.emplace_back("\"" + note + "\"");
+        }
 
         std::size_t i = 0;
         std::string path_stub = path + "/./" + name;
@@ -55,9 +69,102 @@ namespace hdvr {
         }
 
         hype::save_file(form_path(path_stub, i) + ".csv", result);
+
+        if (!latencies.empty()) {
+            std::vector<std::string> latency_result{"name,count,p50_ns,p90_ns,p99_ns,p99.9_ns,max_ns"};
+            for (const auto &[latency_name, histogram]: latencies) {
+                ss << latency_name << "," << histogram.count() << "," << histogram.percentile(50) << ","
+                   << histogram.percentile(90) << "," << histogram.percentile(99) << ","
+                   << histogram.percentile(99.9) << "," << histogram.max();
+                latency_result.emplace_back(ss.str());
+                ss.str("");
+            }
+            hype::save_file(form_path(path_stub, i) + "_latency.csv", latency_result);
+        }
+    }
+
+    void Metrics::log(std::size_t epoch, float error, std::optional<float> accuracy,
+                      std::optional<float> validation_accuracy, float seconds) {
+        data.emplace_back(Data{epoch, error, accuracy, validation_accuracy, seconds});
+    }
+
+    void Metrics::note(const std::string &note) {
+        notes.emplace_back(note);
+    }
+
+    std::optional<float> Metrics::last_accuracy() const {
+        for (auto it = data.rbegin(); it != data.rend(); ++it) {
+            if (it->accuracy.has_value()) {
+                return it->accuracy;
+            }
+        }
+        return std::nullopt;
+    }
+
+    namespace {
+        std::optional<float> optional_float(const std::string &str) {
+            if (str.empty()) {
+                return std::nullopt;
+            }
+            return std::stof(str);
+        }
+    } // namespace
+
+    void Metrics::serialize(std::ostream &os) const {
+        auto precision = os.precision(std::numeric_limits<float>::max_digits10);
+        os << header << "\n" << data.size() << "\n";
+        for (const auto &dp: data) {
+            os << dp.epoch << "," << dp.error << ",";
+            if (dp.accuracy.has_value()) {
+                os << *dp.accuracy;
+            }
+            os << ",";
+            if (dp.validation_accuracy.has_value()) {
+                os << *dp.validation_accuracy;
+            }
+            os << "," << dp.seconds << "\n";
+        }
+        os << notes.size() << "\n";
+        for (const auto &note: notes) {
+            os << note << "\n";
+        }
+        os.precision(precision);
+    }
+
+    Metrics Metrics::deserialize(std::istream &is) {
+        std::string line;
+        if (!std::getline(is, line)) {
+            throw hype::error("Failed to read metrics: missing header.");
+        }
+        Metrics result(line);
+
+        std::getline(is, line);
+        std::size_t rows = std::stoul(line);
+        for (std::size_t i = 0; i < rows; ++i) {
+            if (!std::getline(is, line)) {
+                throw hype::error("Failed to read metrics: expected ", rows, " epochs but found ", i, ".");
+            }
+            std::stringstream row(line);
+            std::array<std::string, 5> fields;
+            for (auto &field: fields) {
+                std::getline(row, field, ',');
+            }
+            result.log(std::stoul(fields[0]), std::stof(fields[1]), optional_float(fields[2]),
+                       optional_float(fields[3]), std::stof(fields[4]));
+        }
+
+        std::getline(is, line);
+        std::size_t notes = std::stoul(line);
+        for (std::size_t i = 0; i < notes; ++i) {
+            if (!std::getline(is, line)) {
+                throw hype::error("Failed to read metrics: expected ", notes, " notes but found ", i, ".");
+            }
+            result.note(line);
+        }
+        return result;
     }
 
-    void Metrics::log(std::size_t epoch, float error, float accuracy) {
-        data.emplace_back(Data{epoch, error, accuracy});
+    void Metrics::latency(const std::string &name, const hype::LatencyHistogram &histogram) {
+        latencies.emplace_back(name, histogram);
     }
 } // namespace hdvr
\ No newline at end of file
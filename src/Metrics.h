@@ -19,7 +19,13 @@
 
 #pragma once
 
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
+#include <optional>
+
+#include "hype/Histogram.h"
 
 namespace hdvr {
     class Metrics {
@@ -27,11 +33,15 @@ namespace hdvr {
         struct Data {
             std::size_t epoch;
             float error;
-            float accuracy;
+            std::optional<float> accuracy;
+            std::optional<float> validation_accuracy;
+            float seconds;
         };
 
         std::string header;
         std::vector<Data> data;
+        std::vector<std::string> notes;
+        std::vector<std::pair<std::string, hype::LatencyHistogram>> latencies;
 
         std::string form_path(const std::string &stub, std::size_t it);
 
@@ -40,6 +50,21 @@ namespace hdvr {
 
         void save(const std::string &path, const std::string &name);
 
-        void log(std::size_t epoch, float error, float accuracy);
+        void log(std::size_t epoch, float error, std::optional<float> accuracy,
+                 std::optional<float> validation_accuracy = std::nullopt, float seconds = 0);
+
+        void note(const std::string &note);
+
+        // Test accuracy of the last evaluated epoch.
+        [[nodiscard]]
+        std::optional<float> last_accuracy() const;
+
+        // Saved by save() next to the epochs, as <name><n>_latency.csv.
+        void latency(const std::string &name, const hype::LatencyHistogram &histogram);
+
+        // Round trip of the header, epochs and notes, e.g. to resume training. Latencies are not kept.
+        void serialize(std::ostream &os) const;
+
+        static Metrics deserialize(std::istream &is);
     };
 } // namespace hdvr
\ No newline at end of file
@@ -25,19 +25,45 @@
 #include "hype/AssociativeMemory.h"
 #include "hype/FrequencyChannelMemory.h"
 
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <sstream>
+#include <string>
+
 
 namespace hdvr {
 
+// File in a model directory naming the version saved last. It is written once the version is complete, so whatever it
+// names can be loaded.
+#define MODEL_MARKER "current"
+
+    // Models are saved into a new version directory next to the previous ones, after which the marker is switched to
+    // it, so that a model is never read while it is being written. Models saved before versions existed keep their files
+    // in the model directory itself, and are still loaded from there.
     template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
     class Model {
     public:
         Model() : continuousItemMemory(L, D, S), frequencyChannelMemory(F, D, S) {}
 
+        // Loads the model saved in `path` without generating item memories first. Throws if it cannot be loaded.
+        explicit Model(const std::string &path) : Model(path, saved_version(path)) {}
+
+        // Loads `version` of the model saved in `path`, as named by saved_version().
+        Model(const std::string &path, const std::string &version)
+                : continuousItemMemory(files(path, version) + "/./continuous_memory.mem"),
+                  frequencyChannelMemory(files(path, version) + "/./level_memory.mem") {
+            associativeMemory.load(files(path, version) + "/./associative_memory.mem");
+            load_mask(files(path, version));
+        }
+
         bool load(const std::string &path) {
             try {
-                associativeMemory.load(path + "/./associative_memory.mem");
-                continuousItemMemory.load(path + "/./continuous_memory.mem");
-                frequencyChannelMemory.load(path + "/./level_memory.mem");
+                std::string directory = files(path, saved_version(path));
+                associativeMemory.load(directory + "/./associative_memory.mem");
+                continuousItemMemory.load(directory + "/./continuous_memory.mem");
+                frequencyChannelMemory.load(directory + "/./level_memory.mem");
+                load_mask(directory);
                 return true;
             } catch (std::runtime_error e) {
                 *this = Model<L, D, F, S>();
@@ -45,11 +71,29 @@ namespace hdvr {
             }
         }
 
+        // Saves the model as the next version in `path`. Every file is written atomically and the marker last, and
+        // versions older than the one before are removed, as a reader may still be loading that one.
         bool save(const std::string &path) {
             try {
-                associativeMemory.save(path + "/./associative_memory.mem");
-                continuousItemMemory.save(path + "/./continuous_memory.mem");
-                frequencyChannelMemory.save(path + "/./level_memory.mem");
+                std::size_t number = version_number(saved_version(path)) + 1;
+                std::string version = "v" + std::to_string(number);
+                std::string directory = files(path, version);
+                hype::make_directories(directory);
+                hype::save_file_atomically(directory + "/./associative_memory.mem", serialize(associativeMemory));
+                hype::save_file_atomically(directory + "/./continuous_memory.mem", serialize(continuousItemMemory));
+                hype::save_file_atomically(directory + "/./level_memory.mem", serialize(frequencyChannelMemory));
+                auto mask = frequencyChannelMemory.mask();
+                hype::save_file_atomically(directory + "/./channel_mask.mem",
+                                           serialize(std::vector<int>(mask.begin(), mask.end())));
+                hype::save_file_atomically(path + "/./" MODEL_MARKER, version + "\n");
+
+                for (const auto &entry: std::filesystem::directory_iterator(path)) {
+                    std::size_t old = version_number(entry.path().filename().string());
+                    if (entry.is_directory() && old > 0 && old + 1 < number) {
+                        std::error_code ignored;
+                        std::filesystem::remove_all(entry.path(), ignored);
+                    }
+                }
                 return true;
             } catch (std::runtime_error &e) {
                 hype::log_error_nl("Failed to save model: ", e.what());
@@ -61,6 +105,56 @@ namespace hdvr {
             return associativeMemory.size() == 0 && continuousItemMemory.size() == 0 && frequencyChannelMemory.size() == 0;
         }
 
+        // The version saved last in `path`, or an empty string if none was, e.g. for models saved before versions.
+        static std::string saved_version(const std::string &path) {
+            std::string marker = path + "/./" MODEL_MARKER;
+            if (!hype::is_file(marker)) {
+                return "";
+            }
+            std::string version = hype::read_file_directly(marker);
+            while (!version.empty() && std::isspace(static_cast<unsigned char>(version.back()))) {
+                version.pop_back();
+            }
+            return version;
+        }
+
+    private:
+        static std::string files(const std::string &path, const std::string &version) {
+            return version.empty() ? path : path + "/./" + version;
+        }
+
+        // The number of a version directory named "v<number>", or 0 for any other name.
+        static std::size_t version_number(const std::string &name) {
+            if (name.size() < 2 || name[0] != 'v' ||
+                !std::all_of(name.begin() + 1, name.end(), [](char c) { return std::isdigit(c); })) {
+                return 0;
+            }
+            return std::stoull(name.substr(1));
+        }
+
+        template<typename Elements>
+        static std::string serialize(const Elements &elements) {
+            std::stringstream ss;
+            for (const auto &element: elements) {
+                ss << element << "\n";
+            }
+            return ss.str();
+        }
+
+        // Models saved before channels could be pruned have no mask, and keep every channel.
+        void load_mask(const std::string &path) {
+            std::string mask_path = path + "/./channel_mask.mem";
+            if (!hype::is_file(mask_path)) {
+                frequencyChannelMemory.mask({});
+                return;
+            }
+            auto flags = hype::read_file<int>(mask_path);
+            if (flags.size() != F) {
+                throw hype::error("Channel mask in ", mask_path, " has ", flags.size(), " channels; expected ", F, ".");
+            }
+            frequencyChannelMemory.mask(std::vector<bool>(flags.begin(), flags.end()));
+        }
+
     public:
         hype::AssociativeMemory<Vect<D>> associativeMemory;
         hype::ContinuousItemMemory<Vect<D>> continuousItemMemory;
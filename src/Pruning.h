@@ -0,0 +1,171 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Dataset.h"
+#include "Frequency.h"
+#include "Types.h"
+#include "hype/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace hdvr {
+
+    // Scores every channel of a raw dataset; higher scores are more informative. Mutual information is estimated from
+    // the values quantised into `bins` equal bins over [MIN_FREQUENCY, MAX_FREQUENCY], in bits; values outside
+    // that range count towards the nearest bin.
+    template<std::size_t F>
+    std::vector<float> score_channels(const Dataset<hype::Vector<F, data_t>, int> &dataset, ChannelScore score,
+                                      int bins = 16) {
+        if (dataset.size() == 0) {
+            throw hype::error("Cannot score channels of an empty dataset.");
+        }
+        std::size_t n = dataset.size();
+        std::vector<float> result(F, 0.0f);
+
+        if (score == VARIANCE) {
+            for (std::size_t f = 0; f < F; ++f) {
+                double mean = 0.0;
+                double squares = 0.0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    double value = dataset[i].first[f];
+                    mean += value;
+                    squares += value * value;
+                }
+                mean /= n;
+                result[f] = static_cast<float>(squares / n - mean * mean);
+            }
+            return result;
+        }
+
+        int classes = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (dataset[i].second < 0) {
+                throw hype::error("Cannot score channels: encountered negative label (", dataset[i].second, ").");
+            }
+            classes = std::max(classes, dataset[i].second + 1);
+        }
+        std::vector<double> class_counts(classes, 0.0);
+        for (std::size_t i = 0; i < n; ++i) {
+            ++class_counts[dataset[i].second];
+        }
+
+        std::vector<double> joint(bins * classes);
+        std::vector<double> bin_counts(bins);
+        for (std::size_t f = 0; f < F; ++f) {
+            std::fill(joint.begin(), joint.end(), 0.0);
+            std::fill(bin_counts.begin(), bin_counts.end(), 0.0);
+            for (std::size_t i = 0; i < n; ++i) {
+                int bin = frequency_bin(dataset[i].first[f], bins);
+                ++joint[bin * classes + dataset[i].second];
+                ++bin_counts[bin];
+            }
+
+            double information = 0.0;
+            for (int b = 0; b < bins; ++b) {
+                for (int c = 0; c < classes; ++c) {
+                    double count = joint[b * classes + c];
+                    if (count > 0) {
+                        information += count / n * std::log2(count * n / (bin_counts[b] * class_counts[c]));
+                    }
+                }
+            }
+            result[f] = static_cast<float>(information);
+        }
+        return result;
+    }
+
+    // Channels by descending score, ties broken by position.
+    inline std::vector<std::size_t> rank_channels(const std::vector<float> &scores) {
+        std::vector<std::size_t> order(scores.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return scores[a] > scores[b];
+        });
+        return order;
+    }
+
+    // Keeps the `keep` channels with the highest scores, breaking ties by position.
+    inline std::vector<bool> channel_mask(const std::vector<float> &scores, std::size_t keep) {
+        auto order = rank_channels(scores);
+        std::vector<bool> result(scores.size(), false);
+        for (std::size_t i = 0; i < std::min(keep, order.size()); ++i) {
+            result[order[i]] = true;
+        }
+        return result;
+    }
+
+    // Like channel_mask(), but also drops redundant channels: walking down the ranking, a channel is skipped when the
+    // absolute correlation of its values in `dataset` with those of a channel already kept exceeds `max_correlation`.
+    // Keeps fewer than `keep` channels when not enough are left.
+    template<std::size_t F>
+    std::vector<bool> channel_mask(const Dataset<hype::Vector<F, data_t>, int> &dataset, const std::vector<float> &scores,
+                                   std::size_t keep, float max_correlation) {
+        if (dataset.size() == 0 || scores.size() != F) {
+            throw hype::error("Cannot decorrelate ", scores.size(), " channel scores over ", dataset.size(), " samples.");
+        }
+        std::size_t n = dataset.size();
+
+        // Every channel's values centred and scaled to unit norm, so that correlations are dot products. Constant
+        // channels stay zero and correlate with nothing.
+        std::vector<float> normalised(F * n);
+        for (std::size_t f = 0; f < F; ++f) {
+            double mean = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                mean += dataset[i].first[f];
+            }
+            mean /= n;
+            double norm = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                double centred = dataset[i].first[f] - mean;
+                normalised[f * n + i] = static_cast<float>(centred);
+                norm += centred * centred;
+            }
+            norm = std::sqrt(norm);
+            for (std::size_t i = 0; i < n; ++i) {
+                normalised[f * n + i] = norm > 0 ? static_cast<float>(normalised[f * n + i] / norm) : 0.0f;
+            }
+        }
+
+        std::vector<bool> result(F, false);
+        std::vector<std::size_t> kept;
+        for (auto candidate: rank_channels(scores)) {
+            if (kept.size() == keep) {
+                break;
+            }
+            bool redundant = std::any_of(kept.begin(), kept.end(), [&](std::size_t other) {
+                float correlation = std::inner_product(normalised.begin() + candidate * n,
+                                                       normalised.begin() + (candidate + 1) * n,
+                                                       normalised.begin() + other * n, 0.0f);
+                return std::abs(correlation) > max_correlation;
+            });
+            if (!redundant) {
+                kept.push_back(candidate);
+                result[candidate] = true;
+            }
+        }
+        return result;
+    }
+
+} // namespace hdvr
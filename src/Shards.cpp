@@ -0,0 +1,120 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Shards.h"
+#include "hype/Utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace hdvr {
+
+    Shards::Shards(std::size_t count_, std::size_t slot_size_, bool processes_) : count(count_),
+                                                                                 slot_size(slot_size_),
+                                                                                 processes(processes_),
+                                                                                 slots(nullptr) {
+        if (count == 0) {
+            throw hype::error("Cannot split work into zero shards.");
+        }
+
+        if (processes) {
+            void *memory = mmap(nullptr, count * slot_size * sizeof(float), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                throw hype::error("Could not map shared memory for ", count, " shards: ", std::strerror(errno));
+            }
+            slots = static_cast<float *>(memory);
+        } else {
+            local_slots.resize(count * slot_size);
+            slots = local_slots.data();
+        }
+    }
+
+    Shards::~Shards() {
+        if (processes) {
+            munmap(slots, count * slot_size * sizeof(float));
+        }
+    }
+
+    void Shards::run(const std::function<void(std::size_t, float *)> &work) {
+        std::memset(slots, 0, count * slot_size * sizeof(float));
+
+        if (!processes) {
+            for (std::size_t shard = 0; shard < count; ++shard) {
+                work(shard, slots + shard * slot_size);
+            }
+            return;
+        }
+
+        // Anything still buffered would otherwise be written once more by every worker.
+        std::cout.flush();
+        std::cerr.flush();
+
+        std::vector<pid_t> workers;
+        for (std::size_t shard = 0; shard < count; ++shard) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    work(shard, slots + shard * slot_size);
+                } catch (std::exception &e) {
+                    hype::log_error_nl("Shard ", shard, " failed: ", e.what());
+                    status = 1;
+                }
+                // Skip the parent's destructors and atexit handlers.
+                _exit(status);
+            } else if (pid < 0) {
+                for (const auto &worker: workers) {
+                    waitpid(worker, nullptr, 0);
+                }
+                throw hype::error("Could not fork worker for shard ", shard, ": ", std::strerror(errno));
+            }
+            workers.emplace_back(pid);
+        }
+
+        std::size_t failures = 0;
+        for (const auto &worker: workers) {
+            int status = 0;
+            if (waitpid(worker, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ++failures;
+            }
+        }
+        if (failures > 0) {
+            throw hype::error(failures, " of ", count, " shard workers failed.");
+        }
+    }
+
+    const float *Shards::slot(std::size_t shard) const {
+        return slots + shard * slot_size;
+    }
+
+    std::size_t Shards::size() const {
+        return count;
+    }
+
+    std::pair<std::size_t, std::size_t> Shards::range(std::size_t shard, std::size_t total) const {
+        return {shard * total / count, (shard + 1) * total / count};
+    }
+
+} // namespace hdvr
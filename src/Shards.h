@@ -0,0 +1,60 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace hdvr {
+    // Runs a computation split into shards, each of which writes its partial result into its own slot of floats. With
+    // `processes` set, every shard runs in a forked worker process and the slots live in shared memory, so the parent
+    // can reduce them once all workers have exited. Otherwise the shards run one after another in this process. Slots
+    // are zeroed before every run and reduced in shard order, so both modes give identical results. No other thread
+    // may run while the workers are forked, as any lock it held would stay held in every worker.
+    class Shards {
+    public:
+        Shards(std::size_t count, std::size_t slot_size, bool processes);
+
+        ~Shards();
+
+        Shards(const Shards &) = delete;
+
+        Shards &operator=(const Shards &) = delete;
+
+        void run(const std::function<void(std::size_t, float *)> &work);
+
+        const float *slot(std::size_t shard) const;
+
+        [[nodiscard]]
+        std::size_t size() const;
+
+        // The [begin, end) range of `total` items assigned to `shard`.
+        std::pair<std::size_t, std::size_t> range(std::size_t shard, std::size_t total) const;
+
+    private:
+        std::size_t count;
+        std::size_t slot_size;
+        bool processes;
+        float *slots;
+        std::vector<float> local_slots;
+    };
+} // namespace hdvr
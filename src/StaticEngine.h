@@ -0,0 +1,104 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "Frequency.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace hdvr {
+
+    // Classifies raw samples with an exported model without allocating, throwing or relying on more than a few
+    // standard headers, so that it also runs on small embedded targets. The item memories are bipolar and packed one
+    // bit per component, set where the component is -1. The prototypes are kept as they are, each with its norm.
+    // Nothing is copied: the arrays, usually the ones in a header written by export_model(), must outlive the engine.
+    // The encoding is built in a buffer inside the engine, so concurrent callers need an engine each.
+    template<std::size_t L, std::size_t D, std::size_t F>
+    class StaticEngine {
+    public:
+        static constexpr std::size_t WORDS = (D + 63) / 64;
+
+        constexpr StaticEngine(const std::uint64_t *levels_, const std::uint64_t *channels_, const float *prototypes_,
+                               const float *norms_, std::size_t classes_) noexcept
+                : levels(levels_), channels(channels_), prototypes(prototypes_), norms(norms_), classes(classes_),
+                  encoded{} {}
+
+        // Encodes the F frequencies of a sample like HDVR::encode() does. The result is valid until the next call.
+        const std::int32_t *encode(const float *frequencies) noexcept {
+            encoded.fill(0);
+            for (std::size_t i = 0; i < F; ++i) {
+                const std::uint64_t *level = levels + frequency_bin(frequencies[i], static_cast<int>(L)) * WORDS;
+                const std::uint64_t *channel = channels + i * WORDS;
+                for (std::size_t w = 0; w < WORDS; ++w) {
+                    // Bound components are -1 exactly where one of the two factors is.
+                    std::uint64_t negative = level[w] ^ channel[w];
+                    std::size_t bits = D - w * 64 < 64 ? D - w * 64 : 64;
+                    for (std::size_t b = 0; b < bits; ++b) {
+                        encoded[w * 64 + b] += 1 - 2 * static_cast<std::int32_t>((negative >> b) & 1);
+                    }
+                }
+            }
+            return encoded.data();
+        }
+
+        // Index of the prototype most similar to the sample, by cosine similarity as in the associative memory.
+        std::size_t classify(const float *frequencies) noexcept {
+            encode(frequencies);
+
+            std::size_t best = 0;
+            double best_similarity = -std::numeric_limits<double>::infinity();
+            for (std::size_t c = 0; c < classes; ++c) {
+                if (norms[c] == 0) {
+                    continue;
+                }
+                const float *prototype = prototypes + c * D;
+                double dot = 0.0;
+                for (std::size_t d = 0; d < D; ++d) {
+                    dot += static_cast<double>(encoded[d]) * prototype[d];
+                }
+                // The norm of the encoding is the same for every prototype, so it does not change the ranking.
+                double similarity = dot / norms[c];
+                if (similarity > best_similarity) {
+                    best = c;
+                    best_similarity = similarity;
+                }
+            }
+            return best;
+        }
+
+        [[nodiscard]]
+        constexpr std::size_t size() const noexcept {
+            return classes;
+        }
+
+    private:
+        const std::uint64_t *levels;
+        const std::uint64_t *channels;
+        const float *prototypes;
+        const float *norms;
+        std::size_t classes;
+        std::array<std::int32_t, D> encoded;
+    };
+
+} // namespace hdvr
@@ -0,0 +1,54 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "HDVR.h"
+#include "hype/Permutation.h"
+
+namespace hdvr {
+
+    // Encodes a continuous stream of frames into sliding-window n-grams: every frame is encoded with
+    // HDVR::encode_delta() from the one before and folded into the window incrementally, so the n-gram update costs
+    // O(D) per frame regardless of n.
+    template<std::size_t L, std::size_t D, std::size_t F, hype::SeedingStrategy S>
+    class StreamingEncoder {
+    public:
+        StreamingEncoder(HDVR<L, D, F, S> &hdvr_, std::size_t n) : hdvr(hdvr_), ngram(n) {}
+
+        // Returns a view of the n-gram ending in `frame`, valid until the next call to push() or reset().
+        hype::Rotated<Vect<D>> push(const hype::Vector<F, data_t> &frame) {
+            hdvr.encode_delta(frame, bins, encoded);
+            return ngram.push(encoded);
+        }
+
+        void reset() {
+            ngram.reset();
+            bins.clear();
+        }
+
+    private:
+        HDVR<L, D, F, S> &hdvr;
+        hype::NGram<Vect<D>> ngram;
+        std::vector<int> bins;
+        Vect<D> encoded;
+    };
+
+} // namespace hdvr
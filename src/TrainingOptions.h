@@ -0,0 +1,70 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace hdvr {
+    struct TrainingOptions {
+        int epochs = 10;
+
+        // Re-bundle the prototypes from this fraction of each class before training. Unset keeps the prototypes as
+        // they were configured when the datasets were loaded.
+        std::optional<float> dataset_fraction;
+        // Each retraining update leaves out this fraction of the dimensions, drawn anew for every update.
+        float dropout = 0.0;
+        // Scales every retraining update.
+        float learning_rate = 1.0;
+
+        // Fraction of the training set held out for early stopping. Zero trains on everything and never stops early.
+        float validation_fraction = 0.0;
+        // Number of evaluations without an improvement of more than `min_delta` validation accuracy (in percentage
+        // points) before training stops and the best prototypes are restored.
+        int patience = 2;
+        float min_delta = 0.0;
+
+        // Visit the training samples in a new random order every epoch.
+        bool shuffle = false;
+        // Only evaluate every this many epochs (the last epoch is always evaluated).
+        int evaluation_interval = 1;
+
+        // Seeds the validation split and the shuffling, so that runs are reproducible.
+        unsigned int seed = 0;
+
+        // Retrain in batches split across this many shards. Each shard classifies its part of an epoch against the
+        // prototypes from the start of that epoch, and the summed updates of all shards are applied at its end. Zero
+        // keeps online retraining, which updates the prototypes after every sample.
+        int shards = 0;
+        // Run every shard in its own worker process rather than one after another in this one. Results are identical.
+        bool shard_processes = true;
+
+        // Checkpoint the training state into this directory every `checkpoint_interval` epochs and/or every
+        // `checkpoint_seconds` seconds. Checkpoints are written in the background. Empty disables checkpointing.
+        std::string checkpoint_path;
+        int checkpoint_interval = 0;
+        float checkpoint_seconds = 0;
+        // Carry on from the checkpoint in `checkpoint_path`, if there is one. The model, datasets and options must match
+        // the checkpointed run, except for the number of epochs, which may be raised; training throws otherwise.
+        bool resume = false;
+    };
+} // namespace hdvr
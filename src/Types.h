@@ -19,11 +19,47 @@
 
 #pragma once
 
+#include "hype/SparseVector.h"
 #include "hype/Vector.h"
 
+#include <cstdint>
+#include <ostream>
+
 namespace hdvr {
     using data_t = float;
+    // Building with HDVR_SPARSE_BLOCKS=B makes every hypervector a sparse block code of B blocks instead.
+#ifdef HDVR_SPARSE_BLOCKS
+    template<std::size_t D>
+    using Vect = hype::SparseBlockVector<D, HDVR_SPARSE_BLOCKS>;
+#else
     template<std::size_t D>
     //using Vect = hype::BinaryVector<D>;
     using Vect = hype::Vector<D, data_t>;
+#endif
+
+    // Encoded samples are sums of F bound vectors, so with bipolar or binary item memories every component is an
+    // integer in [-F, F] and fits in 16 bits for any realistic number of frequency points.
+    using encoded_t = std::int16_t;
+    template<std::size_t D>
+    using EncodedVect = hype::Vector<D, encoded_t>;
+
+    // How raw samples are turned into hypervectors. ID-level encoding quantises every feature into a level vector,
+    // binds it to its channel vector and bundles the results. Bound pairs compute the same encoding from a table of
+    // packed bound vectors. A random projection takes the signs of a product of the features with a random matrix.
+    enum Encoder {
+        ID_LEVEL,
+        BOUND_PAIRS,
+        RANDOM_PROJECTION,
+    };
+
+    std::ostream &operator<<(std::ostream &os, Encoder encoder);
+
+    // How input channels are ranked when pruning them: by the variance of their values, or by the mutual information
+    // between their quantised values and the label.
+    enum ChannelScore {
+        VARIANCE,
+        MUTUAL_INFORMATION,
+    };
+
+    std::ostream &operator<<(std::ostream &os, ChannelScore score);
 } // namespace hdvr
\ No newline at end of file
@@ -0,0 +1,137 @@
+//
+// Copyright 2024 Nikolaj Banke Jensen.
+//
+// This file is part of HDVR.
+// 
+// HDVR is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// HDVR is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License 
+// along with HDVR. If not, see <https://www.gnu.org/licenses/>.
+//
+
+// Checks the engine of a header exported by `HDVR export` against HDVR on the saved model it was exported from, and
+// that it classifies without allocating. Run as: StaticEngineTest <model directory> <raw test samples>
+
+#include HDVR_MODEL_HEADER
+#include "HDVR.h"
+#include "Model.h"
+#include "hype/Utils.h"
+
+#include <array>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+    // Heap allocations made on this thread while `counting` is set. Every replaceable form of operator new below goes
+    // through allocate(), and every operator delete through release().
+    thread_local bool counting = false;
+    thread_local std::size_t allocations = 0;
+
+    void *allocate(std::size_t size, std::size_t alignment) {
+        if (counting) {
+            ++allocations;
+        }
+        size = size == 0 ? 1 : size;
+        void *result = alignment == 0 ? std::malloc(size)
+                                      : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        if (!result) {
+            throw std::bad_alloc();
+        }
+        return result;
+    }
+
+    void release(void *pointer) noexcept {
+        std::free(pointer);
+    }
+} // namespace
+
+void *operator new(std::size_t size) {
+    return allocate(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return allocate(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    release(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+    release(pointer);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        hype::log_error_nl("Usage: ", argv[0], " <model directory> <raw test samples>");
+        return 2;
+    }
+
+    constexpr std::size_t L = hdvr_model::levels;
+    constexpr std::size_t D = hdvr_model::dimensions;
+    constexpr std::size_t F = hdvr_model::frequency_points;
+    hdvr::Model<L, D, F, hype::POLAR> model(argv[1]);
+    hdvr::HDVR hdvr(model);
+    auto engine = hdvr_model::engine();
+
+    std::size_t agreements = 0;
+    std::size_t samples = 0;
+    hype::for_each_line(argv[2], [&](const std::string &line) {
+        hype::Vector<F, hdvr::data_t> sample(line);
+        std::array<hdvr::data_t, F> frequencies;
+        for (std::size_t i = 0; i < F; ++i) {
+            frequencies[i] = sample[i];
+        }
+        counting = true;
+        std::size_t prediction = engine.classify(frequencies.data());
+        counting = false;
+        agreements += prediction == static_cast<std::size_t>(hdvr.classify(sample));
+        ++samples;
+        return true;
+    });
+
+    hype::log_info_nl("Static engine agrees with HDVR on ", agreements, " of ", samples, " test samples, allocating ",
+                      allocations, " times while classifying.");
+    return samples > 0 && agreements == samples && allocations == 0 ? 0 : 1;
+}